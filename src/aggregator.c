@@ -0,0 +1,465 @@
+// This file is part of "austin" which is released under GPL.
+//
+// See file LICENCE or go to http://www.gnu.org/licenses/ for full license
+// details.
+//
+// Austin is a Python frame stack sampler for CPython.
+//
+// Copyright (c) 2018 Gabriele N. Tornetta <phoenix1987@gmail.com>.
+// All rights reserved.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "platform.h"
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#if defined PL_UNIX
+#include <errno.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+#include "error.h"
+#include "hints.h"
+#include "logging.h"
+#include "sink.h"
+
+#include "aggregator.h"
+
+
+#define AGGREGATOR_BUFFER_SIZE     (1 << 18)
+#define AGGREGATOR_INIT_KEYS            1024
+#define AGGREGATOR_MAX_NAME              128
+#define AGGREGATOR_ID_SIZE                24
+#define AGGREGATOR_UNKNOWN         "unknown"
+
+
+// ---- PRIVATE ---------------------------------------------------------------
+
+// ----------------------------------------------------------------------------
+static ctime_t
+_aggregator__intern(aggregator_t * self, const char * stack) {
+  stack_entry_t * entry = stack_table__get(self->stacks, stack);
+  if (!isvalid(entry))
+    return 0;
+
+  // IDs start from 1 so that a zero slot marks a new stack.
+  if (entry->values[0] == 0) {
+    if (self->n_keys + 1 == self->max_keys) {
+      char ** keys = (char **) realloc(self->keys, (self->max_keys << 1) * sizeof(char *));
+      if (!isvalid(keys))
+        return 0;
+      self->keys      = keys;
+      self->max_keys <<= 1;
+    }
+
+    // The keys of the stack table are never moved, so we can refer to them.
+    self->keys[++self->n_keys] = entry->key;
+    entry->values[0]           = self->n_keys;
+  }
+
+  return entry->values[0];
+} /* _aggregator__intern */
+
+
+// ----------------------------------------------------------------------------
+static int
+_aggregator__service(aggregator_t * self, const char * name) {
+  char safe_name[AGGREGATOR_MAX_NAME];
+
+  // The name ends up in a file name, so only the most harmless characters are
+  // kept.
+  register int i = 0;
+  for (; name[i] != '\0' && i < AGGREGATOR_MAX_NAME - 1; i++)
+    safe_name[i] = isalnum((unsigned char) name[i]) || name[i] == '-' || name[i] == '_' || (name[i] == '.' && i > 0)
+      ? name[i]
+      : '_';
+  safe_name[i] = '\0';
+
+  for (i = 0; i < self->n_services; i++)
+    if (strcmp(self->services[i].name, safe_name) == 0)
+      return i;
+
+  if (self->n_services == AGGREGATOR_MAX_SERVICES) {
+    log_w("Too many services. Samples from %s are discarded", safe_name);
+    return -1;
+  }
+
+  agg_service_t * service = &(self->services[self->n_services]);
+  if (!isvalid(service->name = strdup(safe_name)))
+    return -1;
+  if (!isvalid(service->stacks = stack_table_new())) {
+    sfree(service->name);
+    return -1;
+  }
+
+  log_i("New service: %s", safe_name);
+
+  return self->n_services++;
+} /* _aggregator__service */
+
+
+// ----------------------------------------------------------------------------
+// Write the current aggregate of the service to its profile file and start a
+// new one.
+static void
+_aggregator__write(aggregator_t * self, agg_service_t * service) {
+  if (service->samples == 0)
+    return;
+
+  char * path = (char *) malloc(strlen(self->dir) + AGGREGATOR_MAX_NAME + 32);
+  if (!isvalid(path))
+    return;
+
+  sprintf(path, "%s/%s.%ld.austin", self->dir, service->name, (long) time(NULL));
+  // Profiles written within the same second go to the same file.
+  FILE * output = fopen(path, "a");
+  if (!isvalid(output)) {
+    log_e("Cannot write the profile of service %s to %s", service->name, path);
+    free(path);
+    return;
+  }
+
+  // Tell which markers, if any, the aggregate started from.
+  if (isvalid(service->marker)) {
+    fprintf(output, "%s\n", service->marker);
+    sfree(service->marker);
+  }
+
+  stack_table_t * stacks = service->stacks;
+  for (register size_t i = 0; i < stacks->size; i++) {
+    stack_entry_t * entry = &(stacks->entries[i]);
+    if (entry->key != NULL)
+      fprintf(output, "%s %ld\n", self->keys[strtoul(entry->key, NULL, 16)], (long) entry->values[0]);
+  }
+
+  fclose(output);
+
+  log_i("Profile of service %s: %s (%lu samples)", service->name, path, service->samples);
+
+  stack_table__clear(stacks);
+  service->samples = 0;
+
+  free(path);
+} /* _aggregator__write */
+
+
+// ----------------------------------------------------------------------------
+// Skip the process or thread tag at the start of the stack, if any, so that
+// the samples of all the instances of a service are merged together. The tag
+// is the whole stack of the samples with no frames.
+static char *
+_aggregator__skip_tag(char * stack, char tag) {
+  if (stack[0] != tag)
+    return stack;
+
+  register char * c = stack + 1;
+  while (isalnum((unsigned char) *c))
+    c++;
+
+  if (*c == ';')
+    return c + 1;
+
+  return *c == '\0' ? c : stack;
+} /* _aggregator__skip_tag */
+
+
+// ----------------------------------------------------------------------------
+static void
+_aggregator__add_line(aggregator_t * self, agg_client_t * client, char * line) {
+  size_t header_len = sizeof(AGGREGATOR_SERVICE) - 1;
+
+  if (strncmp(line, AGGREGATOR_SERVICE, header_len) == 0) {
+    client->service = _aggregator__service(self, line + header_len);
+    return;
+  }
+
+  if (client->service < 0)
+    client->service = _aggregator__service(self, AGGREGATOR_UNKNOWN);
+  if (client->service < 0)
+    return;
+
+  agg_service_t * service = &(self->services[client->service]);
+
+  // A marker ends the current aggregate of the service and starts a new one.
+  // Markers that come with no samples in between are kept together.
+  if (strncmp(line, SINK_MARKER, sizeof(SINK_MARKER) - 1) == 0) {
+    _aggregator__write(self, service);
+
+    size_t len    = isvalid(service->marker) ? strlen(service->marker) : 0;
+    char * marker = (char *) realloc(service->marker, len + strlen(line) + 2);
+    if (!isvalid(marker))
+      return;
+    if (len)
+      marker[len++] = '\n';
+    strcpy(marker + len, line);
+    service->marker = marker;
+    return;
+  }
+
+  if (line[0] == '#')
+    return;
+
+  // Each line is a collapsed stack followed by a single value.
+  char * space = strrchr(line, ' ');
+  if (!isvalid(space) || space == line)
+    return;
+  *space = '\0';
+
+  const char * stack = _aggregator__skip_tag(_aggregator__skip_tag(line, 'P'), 'T');
+  if (*stack == '\0')
+    stack = AGGREGATOR_NO_FRAMES;
+
+  ctime_t id   = _aggregator__intern(self, stack);
+  if (id == 0)
+    return;
+
+  char key[AGGREGATOR_ID_SIZE];
+  sprintf(key, "%lx", id);
+  if (success(stack_table__add(service->stacks, key, 0, (ctime_t) strtol(space + 1, NULL, 10))))
+    service->samples++;
+} /* _aggregator__add_line */
+
+
+#if defined PL_UNIX
+// ----------------------------------------------------------------------------
+static int
+_aggregator__read(aggregator_t * self, agg_client_t * client) {
+  ssize_t n = read(
+    client->fd, client->buffer + client->len, AGGREGATOR_BUFFER_SIZE - client->len
+  );
+  if (n < 0 && errno == EINTR)
+    SUCCESS;
+  if (n <= 0)
+    FAIL;
+
+  char * line = client->buffer;
+  char * end  = client->buffer + client->len + n;
+  char * eol;
+
+  while (isvalid(eol = memchr(line, '\n', end - line))) {
+    *eol = '\0';
+    if (client->skip)
+      client->skip = FALSE;
+    else
+      _aggregator__add_line(self, client, line);
+    line = eol + 1;
+  }
+
+  client->len = end - line;
+  if (client->len == AGGREGATOR_BUFFER_SIZE) {
+    // The line does not fit in the buffer, so we drop it.
+    log_w("Discarding a sample that is too long");
+    client->skip = TRUE;
+    client->len  = 0;
+  }
+  else
+    memmove(client->buffer, line, client->len);
+
+  SUCCESS;
+} /* _aggregator__read */
+
+
+// ----------------------------------------------------------------------------
+static void
+_aggregator__accept(aggregator_t * self) {
+  int fd = accept(self->fd, NULL, NULL);
+  if (fd < 0)
+    return;
+
+  if (self->n_clients == AGGREGATOR_MAX_CLIENTS) {
+    log_w("Too many clients. Connection refused");
+    close(fd);
+    return;
+  }
+
+  agg_client_t * client = &(self->clients[self->n_clients]);
+  if (!isvalid(client->buffer = (char *) malloc(AGGREGATOR_BUFFER_SIZE))) {
+    close(fd);
+    return;
+  }
+  client->fd      = fd;
+  client->service = -1;
+  client->len     = 0;
+  client->skip    = FALSE;
+
+  self->n_clients++;
+} /* _aggregator__accept */
+
+
+// ----------------------------------------------------------------------------
+static void
+_aggregator__close_client(aggregator_t * self, int i) {
+  agg_client_t * client = &(self->clients[i]);
+
+  close(client->fd);
+  sfree(client->buffer);
+
+  *client = self->clients[--self->n_clients];
+  memset(&(self->clients[self->n_clients]), 0, sizeof(agg_client_t));
+} /* _aggregator__close_client */
+#endif
+
+
+// ---- PUBLIC ----------------------------------------------------------------
+
+// ----------------------------------------------------------------------------
+aggregator_t *
+aggregator_new(const char * dir) {
+  #if defined PL_UNIX
+  struct sockaddr_un addr;
+
+  aggregator_t * self = (aggregator_t *) calloc(1, sizeof(aggregator_t));
+  if (!isvalid(self))
+    return NULL;
+
+  self->fd = -1;
+
+  self->dir  = strdup(dir);
+  self->path = (char *) malloc(strlen(dir) + sizeof(AGGREGATOR_SOCKET) + 1);
+  if (!isvalid(self->dir) || !isvalid(self->path))
+    goto error;
+  sprintf(self->path, "%s/%s", dir, AGGREGATOR_SOCKET);
+
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  if (strlen(self->path) >= sizeof(addr.sun_path)) {
+    log_e("Socket path %s is too long", self->path);
+    goto error;
+  }
+  strcpy(addr.sun_path, self->path);
+
+  self->stacks   = stack_table_new();
+  self->keys     = (char **) calloc(AGGREGATOR_INIT_KEYS, sizeof(char *));
+  self->max_keys = AGGREGATOR_INIT_KEYS;
+  if (!isvalid(self->stacks) || !isvalid(self->keys))
+    goto error;
+
+  // A socket left behind by an aggregator that has gone away is replaced, but
+  // not the one of an aggregator that is still running.
+  int probe = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (probe >= 0) {
+    int running = connect(probe, (struct sockaddr *) &addr, sizeof(addr)) == 0;
+    close(probe);
+    if (running) {
+      log_e("Another aggregator is listening on %s", self->path);
+      goto error;
+    }
+  }
+  unlink(self->path);
+
+  if ((self->fd = socket(AF_UNIX, SOCK_STREAM, 0)) < 0)
+    goto error;
+
+  if (
+    bind(self->fd, (struct sockaddr *) &addr, sizeof(addr)) != 0 ||
+    listen(self->fd, AGGREGATOR_MAX_CLIENTS) != 0
+  ) {
+    log_e("Cannot listen on %s", self->path);
+    close(self->fd);
+    self->fd = -1;
+    goto error;
+  }
+
+  log_i("Aggregator listening on %s", self->path);
+
+  return self;
+
+error:
+  aggregator__destroy(self);
+  set_error(EAGGREGATOR);
+  return NULL;
+
+  #else
+  log_e("The aggregator is not supported on this platform");
+  set_error(EAGGREGATOR);
+  return NULL;
+  #endif
+} /* aggregator_new */
+
+
+// ----------------------------------------------------------------------------
+void
+aggregator__poll(aggregator_t * self, int timeout) {
+  #if defined PL_UNIX
+  struct pollfd fds[AGGREGATOR_MAX_CLIENTS + 1];
+
+  fds[0].fd     = self->fd;
+  fds[0].events = POLLIN;
+  for (register int i = 0; i < self->n_clients; i++) {
+    fds[i + 1].fd     = self->clients[i].fd;
+    fds[i + 1].events = POLLIN;
+  }
+
+  if (poll(fds, self->n_clients + 1, timeout) <= 0)
+    return;
+
+  // Clients are closed by moving the last one in their place, so we go
+  // backwards to visit each of them once.
+  for (register int i = self->n_clients - 1; i >= 0; i--) {
+    if (fds[i + 1].revents && fail(_aggregator__read(self, &(self->clients[i]))))
+      _aggregator__close_client(self, i);
+  }
+
+  if (fds[0].revents & POLLIN)
+    _aggregator__accept(self);
+  #endif
+} /* aggregator__poll */
+
+
+// ----------------------------------------------------------------------------
+void
+aggregator__rotate(aggregator_t * self) {
+  for (register int i = 0; i < self->n_services; i++)
+    _aggregator__write(self, &(self->services[i]));
+} /* aggregator__rotate */
+
+
+// ----------------------------------------------------------------------------
+void
+aggregator__destroy(aggregator_t * self) {
+  if (!isvalid(self))
+    return;
+
+  #if defined PL_UNIX
+  while (self->n_clients)
+    _aggregator__close_client(self, self->n_clients - 1);
+
+  if (self->fd >= 0) {
+    close(self->fd);
+    unlink(self->path);
+  }
+  #endif
+
+  for (register int i = 0; i < self->n_services; i++) {
+    sfree(self->services[i].name);
+    sfree(self->services[i].marker);
+    if (isvalid(self->services[i].stacks))
+      stack_table__destroy(self->services[i].stacks);
+  }
+
+  if (isvalid(self->stacks))
+    stack_table__destroy(self->stacks);
+  sfree(self->keys);
+  sfree(self->path);
+  sfree(self->dir);
+
+  free(self);
+} /* aggregator__destroy */
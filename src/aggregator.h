@@ -0,0 +1,122 @@
+// This file is part of "austin" which is released under GPL.
+//
+// See file LICENCE or go to http://www.gnu.org/licenses/ for full license
+// details.
+//
+// Austin is a Python frame stack sampler for CPython.
+//
+// Copyright (c) 2018 Gabriele N. Tornetta <phoenix1987@gmail.com>.
+// All rights reserved.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef AGGREGATOR_H
+#define AGGREGATOR_H
+
+
+#include "stats.h"
+#include "stack_table.h"
+
+
+#define AGGREGATOR_SOCKET             "austin.sock"
+#define AGGREGATOR_SERVICE            "# service: "
+#define AGGREGATOR_NO_FRAMES          "<no frames>"
+#define AGGREGATOR_MAX_CLIENTS                 64
+#define AGGREGATOR_MAX_SERVICES                64
+
+
+typedef struct {
+  int             fd;
+  int             service;
+  char          * buffer;
+  size_t          len;
+  int             skip;     // Discarding the rest of a line that is too long.
+} agg_client_t;
+
+
+typedef struct {
+  char          * name;
+  stack_table_t * stacks;   // Keyed by the ID of the interned stack.
+  ustat_t         samples;
+  char          * marker;   // The markers that started the current aggregate.
+} agg_service_t;
+
+
+typedef struct {
+  char          * dir;
+  char          * path;
+  int             fd;
+
+  agg_client_t    clients[AGGREGATOR_MAX_CLIENTS];
+  int             n_clients;
+
+  agg_service_t   services[AGGREGATOR_MAX_SERVICES];
+  int             n_services;
+
+  // The stacks are interned once for all the services. The first slot of each
+  // entry holds the ID of the stack, which indexes the array of keys.
+  stack_table_t * stacks;
+  char         ** keys;
+  size_t          n_keys;
+  size_t          max_keys;
+} aggregator_t;
+
+
+/**
+ * Create a new aggregator that listens for samples on the Unix socket
+ * AGGREGATOR_SOCKET in the given directory. The aggregated profiles are
+ * written to the same directory.
+ *
+ * @param  char *  the path of the directory.
+ *
+ * @return a pointer to the new aggregator, or NULL on failure.
+ */
+aggregator_t *
+aggregator_new(const char *);
+
+
+/**
+ * Accept new connections and merge the samples that have been received into
+ * the aggregates of their services. Wait for at most the given time if there
+ * is nothing to do.
+ *
+ * @param  aggregator_t  self.
+ * @param  int           the maximum time to wait, in milliseconds.
+ */
+void
+aggregator__poll(aggregator_t *, int);
+
+
+/**
+ * Write the aggregate of each service that has received samples since the
+ * last rotation to a profile file of its own, and start new aggregates. The
+ * profiles are named after the service and the current time, e.g.
+ * myscript.py.1600000000.austin.
+ *
+ * @param  aggregator_t  self.
+ */
+void
+aggregator__rotate(aggregator_t *);
+
+
+/**
+ * Close all the connections and the socket, and destroy the aggregator. The
+ * aggregates that have not been rotated are lost.
+ *
+ * @param  aggregator_t  self.
+ */
+void
+aggregator__destroy(aggregator_t *);
+
+
+#endif // AGGREGATOR_H
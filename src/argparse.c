@@ -23,15 +23,21 @@
 #define ARGPARSE_C
 
 #include <limits.h>
+#include <string.h>
 
+#include "aggregator.h"
 #include "argparse.h"
 #include "austin.h"
 #include "hints.h"
+#include "overhead.h"
 #include "platform.h"
+#include "sink.h"
 
 
 #define DEFAULT_SAMPLING_INTERVAL    100
 #define DEFAULT_INIT_RETRY_CNT       100
+#define DEFAULT_FRAME_WINDOW         0
+#define MAX_FRAME_WINDOW             (1 << 16)
 
 const char SAMPLE_FORMAT_NORMAL[]      = ";%s (%s);L%d";
 const char SAMPLE_FORMAT_ALTERNATIVE[] = ";%s (%s:%d)";
@@ -51,6 +57,28 @@ parsed_args_t pargs = {
   /* output_filename     */ NULL,
   /* children            */ 0,
   /* exposure            */ 0,
+  /* burst_on            */ 0,
+  /* burst_off           */ 0,
+  /* faults              */ 0,
+  /* ctx_switches        */ 0,
+  /* io                  */ 0,
+  /* numa                */ 0,
+  /* t_memory_interval   */ 0,
+  /* smaps               */ 0,
+  /* diff_pid            */ 0,
+  /* proc_mem            */ 0,
+  /* core_file           */ NULL,
+  /* dump                */ 0,
+  /* cgroup              */ NULL,
+  /* heat                */ 0,
+  /* sql                 */ 0,
+  /* sinks               */ {NULL},
+  /* n_sinks             */ 0,
+  /* frame_window        */ DEFAULT_FRAME_WINDOW,
+  /* aggregate           */ NULL,
+  /* markers             */ NULL,
+  /* overhead            */ 0,
+  /* probe               */ NULL,
 };
 
 static int exec_arg = 0;
@@ -140,6 +168,107 @@ parse_timeout(char * str, long * num) {
 }
 
 
+/**
+ * Parse the frame window argument. This is a number of bytes that is either 0
+ * or a power of 2, up to MAX_FRAME_WINDOW.
+ */
+static int
+parse_frame_window(char * str, size_t * size) {
+  long n;
+
+  if (strtonum(str, &n) == 1 || n < 0 || n > MAX_FRAME_WINDOW || (n & (n - 1)))
+    FAIL;
+
+  *size = (size_t) n;
+
+  SUCCESS;
+}
+
+
+// ----------------------------------------------------------------------------
+/**
+ * Parse the burst argument.
+ *
+ * This is of the form ON,OFF, where ON is the duration of each sampling burst
+ * and OFF is the duration of the quiet gap that follows it. Both accept the
+ * same units as the sampling interval and the results are in microseconds.
+ */
+static int
+parse_burst(char * str, long * on, long * off) {
+  char * comma = strchr(str, ',');
+  int    retval;
+
+  if (comma == NULL)
+    FAIL;
+
+  *comma = '\0';
+  retval = parse_interval(str, on) || parse_interval(comma + 1, off);
+  *comma = ',';
+
+  return retval || *on <= 0 || *off <= 0;
+}
+
+
+// ----------------------------------------------------------------------------
+// Check the combination of the options once they have all been parsed, with
+// either parser. Return the error message, or NULL if the options are valid.
+static const char *
+check_args(void) {
+  if (pargs.attach_pid != 0 && exec_arg > 0)
+    return "the -p option is incompatible with the command argument";
+  if (pargs.diff_pid != 0 && pargs.attach_pid == 0)
+    return "the -d option requires the -p option";
+  if (pargs.t_memory_interval && !(pargs.memory || pargs.full || pargs.smaps))
+    return "the -M option requires one of the -m, -f and -S options";
+  if (pargs.diff_pid != 0 && (pargs.memory || pargs.full || pargs.children))
+    return "the -d option is incompatible with the -m, -f and -C options";
+  if (pargs.dump && pargs.attach_pid == 0)
+    return "the -D option requires the -p option";
+  if (pargs.dump && (pargs.memory || pargs.full || pargs.diff_pid))
+    return "the -D option is incompatible with the -m, -f and -d options";
+  if (pargs.core_file != NULL && (exec_arg > 0 || pargs.attach_pid || pargs.children))
+    return "the -k option is incompatible with the command argument and the -p and -C options";
+  if (pargs.core_file != NULL && (
+    pargs.memory || pargs.full || pargs.smaps ||
+    pargs.faults || pargs.ctx_switches || pargs.io || pargs.numa
+  ))
+    return "the -k option only supports time sampling";
+  if (pargs.cgroup != NULL && (
+    exec_arg > 0 || pargs.attach_pid || pargs.children ||
+    pargs.diff_pid || pargs.core_file != NULL || pargs.dump
+  ))
+    return "the -G option is incompatible with the command argument and the -p, -C, -d, -k and -D options";
+  if (pargs.heat && (pargs.diff_pid || pargs.dump))
+    return "the -H option is incompatible with the -d and -D options";
+  if (pargs.heat && (
+    pargs.memory || pargs.full || pargs.smaps ||
+    pargs.faults || pargs.ctx_switches || pargs.io || pargs.numa
+  ))
+    return "the -H option only supports time sampling";
+  if (pargs.sql && (pargs.diff_pid || pargs.dump || pargs.heat))
+    return "the -Q option is incompatible with the -d, -D and -H options";
+  if (pargs.sql && (pargs.faults || pargs.ctx_switches || pargs.io || pargs.numa))
+    return "the -Q option only supports the time and memory metrics";
+  if (pargs.n_sinks && (pargs.diff_pid || pargs.dump || pargs.heat))
+    return "the -O option is incompatible with the -d, -D and -H options";
+  if (pargs.aggregate != NULL && (
+    exec_arg > 0 || pargs.attach_pid || pargs.children || pargs.diff_pid ||
+    pargs.core_file != NULL || pargs.cgroup != NULL || pargs.dump ||
+    pargs.heat || pargs.sql || pargs.n_sinks || pargs.markers != NULL
+  ))
+    return "the -A option is incompatible with the command argument and the -p, -C, -d, -k, -G, -D, -H, -Q, -O and -L options";
+  if (pargs.markers != NULL && (pargs.diff_pid || pargs.dump || pargs.core_file != NULL || pargs.heat))
+    return "the -L option is incompatible with the -d, -D, -k and -H options";
+  if (pargs.overhead && (
+    pargs.children || pargs.diff_pid || pargs.dump ||
+    pargs.core_file != NULL || pargs.cgroup != NULL || pargs.aggregate != NULL
+  ))
+    return "the -X option is incompatible with the -C, -d, -D, -k, -G and -A options";
+
+  return NULL;
+}
+
+
 // ---- GNU C -----------------------------------------------------------------
 
 #ifdef PL_LINUX                                                      /* LINUX */
@@ -196,10 +325,21 @@ static struct argp_option options[] = {
     "full",         'f', NULL,          0,
     "Produce the full set of metrics (time +mem -mem)."
   },
+  {
+    "memory-interval", 'M', "n_us",     0,
+    "Read the memory usage at most once every n_us when profiling memory and "
+    "share the deltas among the samples taken in between. Accepted units: "
+    "s, ms, us."
+  },
   {
     "pid",          'p', "PID",         0,
     "The the ID of the process to which Austin should attach."
   },
+  {
+    "diff",         'd', "PID",         0,
+    "Attach to PID too, sample it together with the process given with -p and "
+    "output the differential profile of the two."
+  },
   {
     "output",       'o', "FILE",        0,
     "Specify an output file for the collected samples."
@@ -208,10 +348,104 @@ static struct argp_option options[] = {
     "children",     'C', NULL,          0,
     "Attach to child processes."
   },
+  {
+    "dump",         'D', NULL,          0,
+    "Print the stacks of all the threads of the process given with -p, and of "
+    "its children with -C, once and exit."
+  },
   {
     "exposure",     'x', "n_sec",       0,
     "Sample for n_sec seconds only."
   },
+  {
+    "burst",        'b', "n_on,n_off",  0,
+    "Sample in bursts of n_on, separated by quiet gaps of n_off. Accepted "
+    "units: s, ms, us."
+  },
+  {
+    "heat",         'H', NULL,          0,
+    "Aggregate the samples by bytecode instruction and output the own and "
+    "total time spent on each instruction of each function."
+  },
+  {
+    "sql",          'Q', NULL,          0,
+    "Output the samples as a SQL script that creates an indexed SQLite "
+    "database."
+  },
+  {
+    "sink",         'O', "KIND:PATH",   0,
+    "Also write the samples to PATH, which is either a file or a FIFO. KIND is "
+    "one of collapsed, aggregated and sql, or unix to send the samples to the "
+    "aggregator listening on the socket PATH. This option can be repeated."
+  },
+  {
+    "aggregate",    'A', "DIR",         0,
+    "Run as an aggregator that listens for samples on the socket DIR/"
+    AGGREGATOR_SOCKET " and writes a profile for each service to DIR every "
+    "n_sec seconds given with -x (default is 60)."
+  },
+  {
+    "markers",      'L', "FIFO",        0,
+    "Read labels from FIFO, one per line, and add a timestamped marker for "
+    "each of them to the samples. Aggregated outputs start a new aggregate "
+    "at each marker. The FIFO is created if it does not exist."
+  },
+  {
+    "frame-window", 'w', "n_bytes",     0,
+    "Read n_bytes of remote memory around each frame and take the frames that "
+    "follow from this local copy when they fall within it. Must be a power of "
+    "2. Set to 0 to read each frame on its own (default)."
+  },
+  #ifdef PL_LINUX
+  {
+    "faults",       'F', NULL,          0,
+    "Append the minor and major page faults of each thread to the metrics."
+  },
+  {
+    "ctx-switches", 'c', NULL,          0,
+    "Append the voluntary and involuntary context switches of each thread to "
+    "the metrics."
+  },
+  {
+    "io",           'I', NULL,          0,
+    "Append the number of bytes read and written by each thread to the "
+    "metrics."
+  },
+  {
+    "smaps",        'S', NULL,          0,
+    "Use the proportional set size from smaps_rollup as the memory metric and "
+    "append its anonymous, file and shared memory parts to the metrics. "
+    "Implies memory mode, unless full mode is requested."
+  },
+  {
+    "proc-mem",     'P', NULL,          0,
+    "Read the memory of the sampled processes from /proc/<pid>/mem instead of "
+    "using process_vm_readv. This is done automatically when the latter is "
+    "not available."
+  },
+  {
+    "numa",         'N', NULL,          0,
+    "Tag each sample with the NUMA node and the CPU on which the thread last "
+    "ran."
+  },
+  {
+    "core",         'k', "FILE",        0,
+    "Print the stacks of all the threads found in the given core file of a "
+    "Python process and exit."
+  },
+  {
+    "cgroup",       'G', "PATH",        0,
+    "Profile every Python process in the given cgroup and its descendants. "
+    "PATH is either absolute or relative to /sys/fs/cgroup."
+  },
+  {
+    "overhead",     'X', "CMD",         OPTION_ARG_OPTIONAL,
+    "Measure the impact of sampling on the process by alternating sampling "
+    "and quiet windows, as set with -b (default is 1s,1s), and report the "
+    "difference. If given, the command CMD is run over and over again as a "
+    "probe of the throughput of the system."
+  },
+  #endif
   #ifndef PL_LINUX
   {
     "help",         '?', NULL
@@ -248,7 +482,8 @@ parse_opt (int key, char *arg, struct argp_state *state)
     state->next = state->argc;
   }
 
-  long l_pid;
+  long         l_pid;
+  const char * message;
   switch(key) {
   case 'i':
     if (
@@ -287,12 +522,26 @@ parse_opt (int key, char *arg, struct argp_state *state)
     pargs.full = 1;
     break;
 
+  case 'M':
+    if (
+      fail(parse_interval(arg, (long *) &(pargs.t_memory_interval))) ||
+      pargs.t_memory_interval == 0 || pargs.t_memory_interval > LONG_MAX
+    )
+      argp_error(state, "the memory interval must be a positive integer");
+    break;
+
   case 'p':
     if (strtonum(arg, &l_pid) == 1 || l_pid <= 0)
       argp_error(state, "invalid PID");
     pargs.attach_pid = (pid_t) l_pid;
     break;
 
+  case 'd':
+    if (strtonum(arg, &l_pid) == 1 || l_pid <= 0)
+      argp_error(state, "invalid PID");
+    pargs.diff_pid = (pid_t) l_pid;
+    break;
+
   case 'o':
     pargs.output_file = fopen(arg, "w");
     if (pargs.output_file == NULL) {
@@ -305,6 +554,10 @@ parse_opt (int key, char *arg, struct argp_state *state)
     pargs.children = 1;
     break;
 
+  case 'D':
+    pargs.dump = 1;
+    break;
+
   case 'x':
     if (
       strtonum(arg, (long *) &(pargs.exposure)) == 1 ||
@@ -313,10 +566,87 @@ parse_opt (int key, char *arg, struct argp_state *state)
       argp_error(state, "the exposure must be a positive integer");
     break;
 
+  case 'b':
+    if (fail(parse_burst(
+      arg, (long *) &(pargs.burst_on), (long *) &(pargs.burst_off)
+    )))
+      argp_error(state, "the burst must be a pair of positive durations");
+    break;
+
+  case 'H':
+    pargs.heat = 1;
+    break;
+
+  case 'Q':
+    pargs.sql = 1;
+    break;
+
+  case 'O':
+    if (pargs.n_sinks == MAX_SINKS)
+      argp_error(state, "too many output sinks");
+    if (sink_kind(arg) < 0)
+      argp_error(state, "the sink must be of the form KIND:PATH, with KIND one of collapsed, aggregated, sql and unix");
+    pargs.sinks[pargs.n_sinks++] = arg;
+    break;
+
+  case 'w':
+    if (fail(parse_frame_window(arg, &(pargs.frame_window))))
+      argp_error(state, "the frame window must be a power of 2, up to 64 KB");
+    break;
+
+  case 'A':
+    pargs.aggregate = arg;
+    break;
+
+  case 'L':
+    pargs.markers = arg;
+    break;
+
+  case 'F':
+    pargs.faults = 1;
+    break;
+
+  case 'c':
+    pargs.ctx_switches = 1;
+    break;
+
+  case 'I':
+    pargs.io = 1;
+    break;
+
+  case 'N':
+    pargs.numa = 1;
+    break;
+
+  case 'S':
+    pargs.smaps = 1;
+    break;
+
+  case 'P':
+    pargs.proc_mem = 1;
+    break;
+
+  case 'k':
+    pargs.core_file = arg;
+    break;
+
+  case 'G':
+    pargs.cgroup = arg;
+    break;
+
+  case 'X':
+    pargs.overhead = 1;
+    pargs.probe    = arg;
+    break;
+
   case ARGP_KEY_ARG:
   case ARGP_KEY_END:
-    if (pargs.attach_pid != 0 && exec_arg != 0)
-      argp_error(state, "the -p option is incompatible with the command argument");
+    if (isvalid(message = check_args()))
+      argp_error(state, "%s", message);
+    if (pargs.overhead && !pargs.burst_on) {
+      pargs.burst_on  = OVERHEAD_DEFAULT_WINDOW;
+      pargs.burst_off = OVERHEAD_DEFAULT_WINDOW;
+    }
     break;
 
   default:
@@ -451,20 +781,62 @@ static const char * help_msg = \
 "Austin -- A frame stack sampler for Python.\n"
 "\n"
 "  -a, --alt-format           Alternative collapsed stack sample format.\n"
+"  -A, --aggregate=DIR        Run as an aggregator that listens for samples on\n"
+"                             the socket DIR/austin.sock and writes a profile\n"
+"                             for each service to DIR every n_sec seconds given\n"
+"                             with -x (default is 60).\n"
+"  -b, --burst=n_on,n_off     Sample in bursts of n_on, separated by quiet gaps\n"
+"                             of n_off. Accepted units: s, ms, us.\n"
 "  -C, --children             Attach to child processes.\n"
+"  -d, --diff=PID             Attach to PID too, sample it together with the\n"
+"                             process given with -p and output the differential\n"
+"                             profile of the two.\n"
+"  -D, --dump                 Print the stacks of all the threads of the process\n"
+"                             given with -p, and of its children with -C, once\n"
+"                             and exit.\n"
 "  -e, --exclude-empty        Do not output samples of threads with no frame\n"
 "                             stacks.\n"
 "  -f, --full                 Produce the full set of metrics (time +mem -mem).\n"
+"  -H, --heat                 Aggregate the samples by bytecode instruction and\n"
+"                             output the own and total time spent on each\n"
+"                             instruction of each function.\n"
 "  -i, --interval=n_us        Sampling interval in microseconds (default is\n"
 "                             100). Accepted units: s, ms, us.\n"
+"  -L, --markers=FIFO         Read labels from FIFO, one per line, and add a\n"
+"                             timestamped marker for each of them to the\n"
+"                             samples. Aggregated outputs start a new aggregate\n"
+"                             at each marker. The FIFO is created if it does not\n"
+"                             exist.\n"
 "  -m, --memory               Profile memory usage.\n"
+"  -M, --memory-interval=n_us Read the memory usage at most once every n_us when\n"
+"                             profiling memory and share the deltas among the\n"
+"                             samples taken in between. Accepted units: s, ms,\n"
+"                             us.\n"
 "  -o, --output=FILE          Specify an output file for the collected samples.\n"
+"  -O, --sink=KIND:PATH       Also write the samples to PATH, which is either a\n"
+"                             file or a FIFO. KIND is one of collapsed,\n"
+"                             aggregated and sql, or unix to send the samples to\n"
+"                             the aggregator listening on the socket PATH. This\n"
+"                             option can be repeated.\n"
 "  -p, --pid=PID              The the ID of the process to which Austin should\n"
 "                             attach.\n"
+"  -Q, --sql                  Output the samples as a SQL script that creates an\n"
+"                             indexed SQLite database.\n"
 "  -s, --sleepless            Suppress idle samples.\n"
 "  -t, --timeout=n_ms         Start up wait time in milliseconds (default is\n"
 "                             100). Accepted units: s, ms.\n"
+"  -w, --frame-window=n_bytes Read n_bytes of remote memory around each frame\n"
+"                             and take the frames that follow from this local\n"
+"                             copy when they fall within it. Must be a power of\n"
+"                             2. Set to 0 to read each frame on its own\n"
+"                             (default).\n"
 "  -x, --exposure=n_sec       Sample for n_sec seconds only.\n"
+"  -X, --overhead[=CMD]       Measure the impact of sampling on the process by\n"
+"                             alternating sampling and quiet windows, as set\n"
+"                             with -b (default is 1s,1s), and report the\n"
+"                             difference. If given, the command CMD is run over\n"
+"                             and over again as a probe of the throughput of the\n"
+"                             system.\n"
 "  -?, --help                 Give this help list\n"
 "      --usage                Give a short usage message\n"
 "  -V, --version              Print program version\n"
@@ -475,11 +847,16 @@ static const char * help_msg = \
 "Report bugs to <https://github.com/P403n1x87/austin/issues>.\n";
 
 static const char * usage_msg = \
-"Usage: austin [-aCefms?V] [-i n_us] [-o FILE] [-p PID] [-t n_ms] [-x n_sec]\n"
-"            [--alt-format] [--children] [--exclude-empty] [--full]\n"
-"            [--interval=n_us] [--memory] [--output=FILE] [--pid=PID]\n"
-"            [--sleepless] [--timeout=n_ms] [--exposure=n_sec] [--help]\n"
-"            [--usage] [--version] command [ARG...]\n";
+"Usage: austin [-aCDefHmQs?V] [-A DIR] [-b n_on,n_off] [-d PID] [-i n_us]\n"
+"            [-L FIFO] [-M n_us] [-o FILE] [-O KIND:PATH] [-p PID] [-t n_ms]\n"
+"            [-w n_bytes] [-x n_sec] [-X[CMD]] [--alt-format] [--aggregate=DIR]\n"
+"            [--burst=n_on,n_off] [--children] [--diff=PID] [--dump]\n"
+"            [--exclude-empty] [--full] [--heat] [--interval=n_us]\n"
+"            [--markers=FIFO] [--memory] [--memory-interval=n_us]\n"
+"            [--output=FILE] [--sink=KIND:PATH] [--pid=PID] [--sql]\n"
+"            [--sleepless] [--timeout=n_ms] [--frame-window=n_bytes]\n"
+"            [--exposure=n_sec] [--overhead[=CMD]] [--help] [--usage] [--version]\n"
+"            command [ARG...]\n";
 
 
 static void
@@ -572,6 +949,15 @@ cb(const char opt, const char * arg) {
     pargs.full = 1;
     break;
 
+  case 'M':
+    if (
+      fail(parse_interval((char *) arg, (long *) &(pargs.t_memory_interval))) ||
+      pargs.t_memory_interval == 0 || pargs.t_memory_interval > LONG_MAX
+    ) {
+      arg_error("the memory interval must be a positive integer");
+    }
+    break;
+
   case 'p':
     if (
       strtonum((char *) arg, (long *) &pargs.attach_pid) == 1 ||
@@ -581,6 +967,15 @@ cb(const char opt, const char * arg) {
     }
     break;
 
+  case 'd':
+    if (
+      strtonum((char *) arg, (long *) &pargs.diff_pid) == 1 ||
+      pargs.diff_pid <= 0
+    ) {
+      arg_error("invalid PID");
+    }
+    break;
+
   case 'o':
     pargs.output_file = fopen(arg, "w");
     if (pargs.output_file == NULL) {
@@ -594,6 +989,10 @@ cb(const char opt, const char * arg) {
     pargs.children = 1;
     break;
 
+  case 'D':
+    pargs.dump = 1;
+    break;
+
   case 'x':
     if (
       strtonum((char *) arg, (long *) &(pargs.exposure)) == 1 ||
@@ -603,6 +1002,46 @@ cb(const char opt, const char * arg) {
     }
     break;
 
+  case 'b':
+    if (fail(parse_burst(
+      (char *) arg, (long *) &(pargs.burst_on), (long *) &(pargs.burst_off)
+    ))) {
+      arg_error("the burst must be a pair of positive durations");
+    }
+    break;
+
+  case 'H':
+    pargs.heat = 1;
+    break;
+
+  case 'Q':
+    pargs.sql = 1;
+    break;
+
+  case 'O':
+    if (pargs.n_sinks == MAX_SINKS) {
+      arg_error("too many output sinks");
+    }
+    if (sink_kind(arg) < 0) {
+      arg_error("the sink must be of the form KIND:PATH, with KIND one of collapsed, aggregated, sql and unix");
+    }
+    pargs.sinks[pargs.n_sinks++] = (char *) arg;
+    break;
+
+  case 'w':
+    if (fail(parse_frame_window((char *) arg, &(pargs.frame_window)))) {
+      arg_error("the frame window must be a power of 2, up to 64 KB");
+    }
+    break;
+
+  case 'A':
+    pargs.aggregate = (char *) arg;
+    break;
+
+  case 'L':
+    pargs.markers = (char *) arg;
+    break;
+
   case '?':
     puts(help_msg);
     exit(0);
@@ -640,6 +1079,10 @@ parse_args(int argc, char ** argv) {
 
   #else
   exec_arg = arg_parse(options, cb, argc, argv) - 1;
+
+  const char * message = check_args();
+  if (isvalid(message))
+    arg_error(message);
   #endif
 
   return exec_arg;
@@ -29,6 +29,10 @@
 
 #include "stats.h"
 
+
+#define MAX_SINKS                      8
+
+
 typedef struct {
   ctime_t   t_sampling_interval;
   ctime_t   timeout;
@@ -42,11 +46,36 @@ typedef struct {
   char    * output_filename;
   int       children;
   ctime_t   exposure;
+  ctime_t   burst_on;
+  ctime_t   burst_off;
+  int       faults;
+  int       ctx_switches;
+  int       io;
+  int       numa;
+  ctime_t   t_memory_interval;
+  int       smaps;
+  pid_t     diff_pid;
+  int       proc_mem;
+  char    * core_file;
+  int       dump;
+  char    * cgroup;
+  int       heat;
+  int       sql;
+  char    * sinks[MAX_SINKS];
+  int       n_sinks;
+  size_t    frame_window;
+  char    * aggregate;
+  char    * markers;
+  int       overhead;
+  char    * probe;
 } parsed_args_t;
 
 
 #ifndef ARGPARSE_C
 extern parsed_args_t pargs;
+
+extern const char SAMPLE_FORMAT_NORMAL[];
+extern const char SAMPLE_FORMAT_ALTERNATIVE[];
 #endif
 
 
@@ -27,13 +27,16 @@
 #include <sys/types.h>
 #include <unistd.h>
 
+#include "aggregator.h"
 #include "argparse.h"
 #include "austin.h"
 #include "error.h"
 #include "hints.h"
 #include "logging.h"
+#include "markers.h"
 #include "mem.h"
 #include "msg.h"
+#include "overhead.h"
 #include "platform.h"
 #include "python.h"
 #include "stats.h"
@@ -42,6 +45,8 @@
 #include "py_proc.h"
 #include "py_proc_list.h"
 #include "py_thread.h"
+#include "sink.h"
+#include "stack_table.h"
 
 
 // ---- SIGNAL HANDLING -------------------------------------------------------
@@ -56,11 +61,80 @@ signal_callback_handler(int signum)
     interrupt = SIGTERM;
 } /* signal_callback_handler */
 
+
+// ---- BURST SAMPLING --------------------------------------------------------
+
+#define BURST_SLEEP_MAX           100000  // Check for interrupts every 0.1s.
+
+static ctime_t       burst_end_time = 0;
+static unsigned long burst_count    = 0;
+
+
+// ----------------------------------------------------------------------------
+static void
+burst_start(void) {
+  if (!pargs.burst_on)
+    return;
+
+  ctime_t now = gettime();
+
+  burst_end_time = now + pargs.burst_on;
+
+  if (pargs.overhead)
+    overhead_switch(TRUE);
+
+  // Give each burst its own time anchor so that samples can be placed in time.
+  sinks_comment("# burst: %lu @ %luus\n", ++burst_count, now);
+} /* burst_start */
+
+
+// ----------------------------------------------------------------------------
+// Sleep through the quiet gap if the current burst is over. Returns TRUE if a
+// new burst has been started, in which case the sampled processes need to be
+// resumed.
+static int
+burst_pause(ctime_t end_time) {
+  if (!pargs.burst_on)
+    return FALSE;
+
+  ctime_t now = gettime();
+  if (now < burst_end_time)
+    return FALSE;
+
+  if (pargs.overhead)
+    overhead_switch(FALSE);
+
+  // Make the current burst available to consumers while we wait.
+  sinks_flush();
+
+  ctime_t resume_time = now + pargs.burst_off;
+  if (end_time && end_time < resume_time)
+    resume_time = end_time;
+
+  log_t("Burst %lu over. Sleeping for %lu μs", burst_count, resume_time - now);
+
+  while (interrupt == FALSE && (now = gettime()) < resume_time)
+    usleep(resume_time - now < BURST_SLEEP_MAX ? resume_time - now : BURST_SLEEP_MAX);
+
+  if (interrupt != FALSE || (end_time && end_time <= now))
+    return FALSE;
+
+  burst_start();
+
+  return TRUE;
+} /* burst_pause */
+
+
 // ----------------------------------------------------------------------------
 
 // ----------------------------------------------------------------------------
 void
 do_single_process(py_proc_t * py_proc) {
+  if (pargs.overhead && fail(overhead_open(py_proc->pid)))
+    log_w("Cannot measure the overhead on the sampled process");
+
+  burst_start();
+
   if (pargs.exposure == 0) {
     while(interrupt == FALSE) {
       timer_start();
@@ -69,6 +143,10 @@ do_single_process(py_proc_t * py_proc) {
         break;
 
       timer_pause(timer_stop());
+      markers_poll();
+
+      if (burst_pause(0))
+        py_proc__resume(py_proc);
     }
   }
   else {
@@ -81,6 +159,10 @@ do_single_process(py_proc_t * py_proc) {
         break;
 
       timer_pause(timer_stop());
+      markers_poll();
+
+      if (burst_pause(end_time))
+        py_proc__resume(py_proc);
 
       if (end_time < gettime())
         interrupt++;
@@ -95,6 +177,50 @@ do_single_process(py_proc_t * py_proc) {
 } /* do_single_process */
 
 
+// ----------------------------------------------------------------------------
+// A core file is a snapshot of a process, so we take a single sample of it,
+// which is accounted for as a single sampling interval.
+void
+do_core_file(py_proc_t * py_proc) {
+  timer_start();
+
+  py_proc->timestamp = gettime() - pargs.t_sampling_interval;
+  if (fail(py_proc__sample(py_proc)))
+    log_ie("Cannot unwind the thread stacks in the core file");
+
+  timer_stop();
+
+  py_proc__destroy(py_proc);
+} /* do_core_file */
+
+
+// ----------------------------------------------------------------------------
+// Attach to the whole process tree first and then read all the stacks in one
+// go, so that they are as close as possible to a consistent snapshot.
+void
+do_dump(py_proc_t * py_proc) {
+  if (!pargs.children) {
+    timer_start();
+    if (fail(py_proc__dump(py_proc)))
+      log_ie("Cannot dump the thread stacks");
+    timer_stop();
+
+    py_proc__destroy(py_proc);
+    return;
+  }
+
+  py_proc_list_t * list = py_proc_list_new(py_proc);
+  if (list == NULL)
+    return;
+
+  py_proc_list__update(list);
+  py_proc_list__attach_wait(list);
+  py_proc_list__dump(list);
+
+  py_proc_list__destroy(list);
+} /* do_dump */
+
+
 // ----------------------------------------------------------------------------
 void
 do_child_processes(py_proc_t * py_proc) {
@@ -116,18 +242,25 @@ do_child_processes(py_proc_t * py_proc) {
 
     py_proc_list__update(list);
     py_proc_list__add_proc_children(list, ppid);
+    py_proc_list__attach_wait(list);
     if (py_proc_list__is_empty(list)) {
       set_error(pargs.attach_pid == 0 ? EPROCFORK : EPROCATTACH);
       goto release;
     }
   }
 
+  burst_start();
+
   if (pargs.exposure == 0) {
     while (!py_proc_list__is_empty(list) && interrupt == FALSE) {
       ctime_t start_time = gettime();
       py_proc_list__update(list);
       py_proc_list__sample(list);
       timer_pause(gettime() - start_time);
+      markers_poll();
+
+      if (burst_pause(0))
+        py_proc_list__resume(list);
     }
   }
   else {
@@ -138,6 +271,10 @@ do_child_processes(py_proc_t * py_proc) {
       py_proc_list__update(list);
       py_proc_list__sample(list);
       timer_pause(gettime() - start_time);
+      markers_poll();
+
+      if (burst_pause(end_time))
+        py_proc_list__resume(list);
 
       if (end_time < gettime()) interrupt++;
     }
@@ -153,6 +290,193 @@ release:
 } /* do_child_processes */
 
 
+#if defined PL_LINUX
+// ----------------------------------------------------------------------------
+// The processes in the cgroup can come and go at any time, so we keep
+// sampling until we are interrupted, even when the cgroup is empty.
+void
+do_cgroup(py_proc_t * py_proc) {
+  // The processes are attached to by the list itself.
+  py_proc__destroy(py_proc);
+
+  py_proc_list_t * list = py_proc_list_new(NULL);
+  if (list == NULL)
+    return;
+
+  if (fail(py_proc_list__set_cgroup(list, pargs.cgroup))) {
+    set_error(ECGROUP);
+    goto release;
+  }
+
+  ctime_t end_time = 0;
+  if (pargs.exposure) {
+    log_m("🕑 Sampling for %d second%s", pargs.exposure, pargs.exposure != 1 ? "s" : "");
+    end_time = gettime() + pargs.exposure * 1000000;
+  }
+
+  burst_start();
+
+  while (interrupt == FALSE) {
+    ctime_t start_time = gettime();
+    py_proc_list__update(list);
+    py_proc_list__sample(list);
+    timer_pause(gettime() - start_time);
+    markers_poll();
+
+    if (burst_pause(end_time))
+      py_proc_list__resume(list);
+
+    if (end_time && end_time < gettime()) interrupt++;
+  }
+
+release:
+  py_proc_list__destroy(list);
+} /* do_cgroup */
+#endif
+
+
+// ----------------------------------------------------------------------------
+void
+do_diff_processes(py_proc_t * py_proc) {
+  py_proc_t     * procs[2] = {py_proc, py_proc_new()};
+  stack_table_t * stacks   = stack_table_new();
+  unsigned long   tick     = 0;
+  ctime_t         end_time = 0;
+
+  if (!isvalid(procs[1]) || !isvalid(stacks)) {
+    log_ie("Cannot create the differential profile");
+    goto release;
+  }
+
+  if (py_proc__attach(procs[1], pargs.diff_pid, FALSE)) {
+    log_ie("Cannot attach the process to compare");
+    goto release;
+  }
+
+  if (pargs.burst_on)
+    log_w("Burst sampling is not supported in differential mode");
+
+  for (register int i = 0; i < 2; i++) {
+    procs[i]->stacks     = stacks;
+    procs[i]->stack_slot = i;
+  }
+
+  if (pargs.exposure) {
+    log_m("🕑 Sampling for %d second%s", pargs.exposure, pargs.exposure != 1 ? "s" : "");
+    end_time = gettime() + pargs.exposure * 1000000;
+  }
+
+  // Sample the two processes on the same schedule, alternating the order at
+  // every tick so that neither is consistently sampled first.
+  while (
+    interrupt == FALSE
+  &&py_proc__is_running(procs[0]) && py_proc__is_running(procs[1])
+  ) {
+    ctime_t start_time = gettime();
+
+    for (register int i = 0; i < 2; i++) {
+      py_proc_t * proc = procs[(tick + i) & 1];
+      timer_start();
+      py_proc__sample(proc);  // Fail silently
+      proc_stats_record(&(proc->stats), timer_stop(), error != EOK);
+    }
+    tick++;
+
+    timer_pause(gettime() - start_time);
+
+    if (end_time && end_time < gettime())
+      interrupt++;
+  }
+
+  // Normalise the second profile to the number of samples of the first one.
+  stack_table__print_diff(stacks, pargs.output_file,
+    procs[1]->stats.sample_cnt
+    ? (double) procs[0]->stats.sample_cnt / procs[1]->stats.sample_cnt
+    : 0
+  );
+
+  for (register int i = 0; i < 2; i++)
+    proc_stats_log_metrics(&(procs[i]->stats), procs[i]->pid);
+
+release:
+  stack_table__destroy(stacks);
+  py_proc__destroy(procs[1]);
+  py_proc__destroy(procs[0]);
+} /* do_diff_processes */
+
+
+// ---- AGGREGATOR ------------------------------------------------------------
+
+#define AGGREGATOR_POLL_TIMEOUT      100  // Check for interrupts every 0.1s.
+#define AGGREGATOR_ROTATION_PERIOD    60
+
+
+// ----------------------------------------------------------------------------
+void
+do_aggregate(void) {
+  aggregator_t * aggregator = aggregator_new(pargs.aggregate);
+  if (!isvalid(aggregator)) {
+    log_ie("Cannot start the aggregator");
+    return;
+  }
+
+  ctime_t period = (pargs.exposure ? pargs.exposure : AGGREGATOR_ROTATION_PERIOD) * 1000000;
+
+  log_m("🧺 Aggregating the samples sent to %s", aggregator->path);
+  log_i("Rotation period: %lu s", period / 1000000);
+
+  ctime_t rotation_time = gettime() + period;
+  while (interrupt == FALSE) {
+    aggregator__poll(aggregator, AGGREGATOR_POLL_TIMEOUT);
+
+    if (gettime() >= rotation_time) {
+      aggregator__rotate(aggregator);
+      rotation_time += period;
+    }
+  }
+
+  // Write out what has been aggregated since the last rotation.
+  aggregator__rotate(aggregator);
+  aggregator__destroy(aggregator);
+} /* do_aggregate */
+
+
+// ----------------------------------------------------------------------------
+// The name of the service that the samples sent to an aggregator belong to.
+// This is the base name of the first argument of the command that is not an
+// option, e.g. the script run by the interpreter, or of the cgroup or of the
+// core file. Attached processes are named after their PID.
+static const char *
+service_name(char ** argv, int exec_arg) {
+  static char pid[32];
+
+  if (pargs.attach_pid != 0) {
+    sprintf(pid, "%d", pargs.attach_pid);
+    return pid;
+  }
+
+  const char * path = pargs.cgroup != NULL ? pargs.cgroup : pargs.core_file;
+  if (path == NULL && exec_arg > 0) {
+    path = argv[exec_arg];
+    for (register int i = exec_arg + 1; argv[i] != NULL; i++) {
+      if (argv[i][0] != '-') {
+        path = argv[i];
+        break;
+      }
+    }
+  }
+  if (path == NULL)
+    return "unknown";
+
+  #if defined PL_WIN
+  const char * base = strrchr(path, '\\');
+  #else
+  const char * base = strrchr(path, '/');
+  #endif
+  return isvalid(base) && base[1] != '\0' ? base + 1 : path;
+} /* service_name */
+
+
 // ---- MAIN ------------------------------------------------------------------
 
 // ----------------------------------------------------------------------------
@@ -165,13 +489,27 @@ int main(int argc, char ** argv) {
   log_header();
   log_version();
 
-  if (exec_arg <= 0 && pargs.attach_pid == 0) {
+  if (pargs.aggregate != NULL) {
+    signal(SIGINT,  signal_callback_handler);
+    signal(SIGTERM, signal_callback_handler);
+
+    do_aggregate();
+    goto finally;
+  }
+
+  if (exec_arg <= 0 && pargs.attach_pid == 0 && pargs.core_file == NULL && pargs.cgroup == NULL) {
+    _msg(MCMDLINE);
+    retval = -1;
+    goto release;
+  }
+
+  if ((pargs.diff_pid != 0 || pargs.dump) && pargs.attach_pid == 0) {
     _msg(MCMDLINE);
     retval = -1;
     goto release;
   }
 
-  if (pargs.attach_pid == 0 && argv[exec_arg] == NULL) {
+  if (pargs.attach_pid == 0 && pargs.core_file == NULL && pargs.cgroup == NULL && argv[exec_arg] == NULL) {
     set_error(ECMDLINE);
     goto finally;
   }
@@ -187,9 +525,32 @@ int main(int argc, char ** argv) {
     goto finally;
   }
 
+  // Open the outputs before starting anything that we might need to stop.
+  if (fail(sinks_open(service_name(argv, exec_arg)))) {
+    log_ie("Cannot open the output sinks");
+    goto finally;
+  }
+
+  if (fail(markers_open())) {
+    log_ie("Cannot open the marker channel");
+    goto finally;
+  }
+
   // Initialise sampling metrics.
   stats_reset();
 
+  #if defined PL_LINUX
+  if (pargs.core_file != NULL) {
+    if (fail(py_proc__attach_core(py_proc, pargs.core_file))) {
+      log_ie("Cannot read the core file");
+      goto finally;
+    }
+  }
+  else if (pargs.cgroup != NULL) {
+    // The processes in the cgroup are attached to while sampling.
+  }
+  else
+  #endif
   if (pargs.attach_pid == 0) {
     if (py_proc__start(py_proc, argv[exec_arg], (char **) &argv[exec_arg]) && !pargs.children) {
       log_ie("Cannot start the process");
@@ -197,7 +558,8 @@ int main(int argc, char ** argv) {
       goto finally;
     }
   } else {
-    if (py_proc__attach(py_proc, pargs.attach_pid, FALSE) && !pargs.children) {
+    // Make a single attempt when dumping as we want the stacks right away.
+    if (py_proc__attach(py_proc, pargs.attach_pid, pargs.dump) && !pargs.children) {
       log_ie("Cannot attach the process");
       goto finally;
     }
@@ -214,6 +576,9 @@ int main(int argc, char ** argv) {
 
   log_i("Sampling interval: %lu μs", pargs.t_sampling_interval);
 
+  if (pargs.burst_on)
+    log_i("Burst sampling: %lu μs on, %lu μs off", pargs.burst_on, pargs.burst_off);
+
   if (pargs.full) {
     if (pargs.memory)
       log_w("Requested full metrics. The memory switch is redundant");
@@ -221,13 +586,28 @@ int main(int argc, char ** argv) {
     pargs.memory = 1;
   }
 
+  if (pargs.smaps) {
+    log_i("Memory source: smaps_rollup (pss anon file shmem)");
+    pargs.memory = 1;
+  }
+
   // Register signal handler for Ctrl+C and terminate signals.
   signal(SIGINT,  signal_callback_handler);
   signal(SIGTERM, signal_callback_handler);
 
   // Start sampling
-  if (pargs.children)
+  if (pargs.core_file != NULL)
+    do_core_file(py_proc);
+  else if (pargs.dump)
+    do_dump(py_proc);
+  #if defined PL_LINUX
+  else if (pargs.cgroup != NULL)
+    do_cgroup(py_proc);
+  #endif
+  else if (pargs.children)
     do_child_processes(py_proc);
+  else if (pargs.diff_pid)
+    do_diff_processes(py_proc);
   else
     do_single_process(py_proc);
   // The above procedures take ownership of py_proc and are responsible for
@@ -237,10 +617,19 @@ int main(int argc, char ** argv) {
   if (error == EPROCNPID)
     error = EOK;
 
+  if (pargs.heat)
+    py_thread_print_heat();
+
   // Log sampling metrics
   stats_log_metrics();
 
+  if (pargs.overhead)
+    overhead_log_report();
+
 finally:
+  overhead_close();
+  markers_close();
+  sinks_close();
   py_thread_free_stack();
   sfree(py_proc);
 
@@ -263,6 +652,20 @@ finally:
     case EPROCATTACH:
       _msg(MATTACH);
       break;
+    #if defined PL_LINUX
+    case ECGROUP:
+      _msg(MCGROUP);
+      break;
+    #endif
+    case ESINK:
+      _msg(MSINK);
+      break;
+    case EAGGREGATOR:
+      _msg(MAGGREGATOR);
+      break;
+    case EMARKERS:
+      _msg(MMARKERS);
+      break;
     case EPROCNPID:
       _msg(MNOPROC);
       break;
@@ -0,0 +1,356 @@
+// This file is part of "austin" which is released under GPL.
+//
+// See file LICENCE or go to http://www.gnu.org/licenses/ for full license
+// details.
+//
+// Austin is a Python frame stack sampler for CPython.
+//
+// Copyright (c) 2018 Gabriele N. Tornetta <phoenix1987@gmail.com>.
+// All rights reserved.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "platform.h"
+
+#if defined PL_LINUX
+
+#include <elf.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/procfs.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "core.h"
+#include "hints.h"
+#include "logging.h"
+
+#ifndef NT_FILE
+#define NT_FILE                   0x46494c45
+#endif
+
+#define NOTE_ALIGN(n)             (((n) + 3) & ~3)
+
+
+// ----------------------------------------------------------------------------
+static char *
+_map_file(const char * path, size_t * size) {
+  struct stat s;
+  char      * image = NULL;
+
+  int fd = open(path, O_RDONLY);
+  if (fd < 0)
+    return NULL;
+
+  if (fstat(fd, &s) == 0 && s.st_size > 0) {
+    image = mmap(NULL, s.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (image == MAP_FAILED)
+      image = NULL;
+    else
+      *size = s.st_size;
+  }
+
+  close(fd);
+
+  return image;
+} /* _map_file */
+
+
+// ----------------------------------------------------------------------------
+// The NT_FILE note is made of the number of mappings and the page size,
+// followed by a (start, end, page offset) triple for each mapping, followed
+// by as many NUL-terminated file names.
+static int
+_core__parse_file_note(core_t * self, char * desc, size_t size) {
+  uint64_t * header = (uint64_t *) desc;
+  if (size < 2 * sizeof(uint64_t))
+    FAIL;
+
+  uint64_t   count     = header[0];
+  uint64_t   page_size = header[1];
+  uint64_t * entries   = header + 2;
+  char     * name      = (char *) (entries + 3 * count);
+  char     * end       = desc + size;
+
+  if (name > end)
+    FAIL;
+
+  self->maps       = (core_map_t *) calloc(count, sizeof(core_map_t));
+  self->files      = (char **)      calloc(count, sizeof(char *));
+  self->file_sizes = (size_t *)     calloc(count, sizeof(size_t));
+  if (!isvalid(self->maps) || !isvalid(self->files) || !isvalid(self->file_sizes))
+    FAIL;
+
+  for (register int i = 0; i < count && name < end; i++) {
+    self->maps[i].lower  = (void *) entries[3 * i];
+    self->maps[i].upper  = (void *) entries[3 * i + 1];
+    self->maps[i].offset = entries[3 * i + 2] * page_size;
+    self->maps[i].path   = name;
+    self->map_count++;
+
+    name += strnlen(name, end - name) + 1;
+  }
+
+  SUCCESS;
+} /* _core__parse_file_note */
+
+
+// ----------------------------------------------------------------------------
+static int
+_core__parse_notes(core_t * self, char * notes, size_t size) {
+  char  * p   = notes;
+  char  * end = notes + size;
+  pid_t   tid = 0;
+
+  while (p + sizeof(Elf64_Nhdr) <= end) {
+    Elf64_Nhdr * nhdr = (Elf64_Nhdr *) p;
+    char       * desc = p + sizeof(Elf64_Nhdr) + NOTE_ALIGN(nhdr->n_namesz);
+
+    if (desc + nhdr->n_descsz > end)
+      break;
+
+    switch (nhdr->n_type) {
+    case NT_PRPSINFO:
+      if (nhdr->n_descsz >= sizeof(struct elf_prpsinfo))
+        self->pid = ((struct elf_prpsinfo *) desc)->pr_pid;
+      break;
+
+    case NT_PRSTATUS:
+      if (tid == 0 && nhdr->n_descsz >= sizeof(struct elf_prstatus))
+        tid = ((struct elf_prstatus *) desc)->pr_pid;
+      break;
+
+    case NT_FILE:
+      if (self->maps == NULL && fail(_core__parse_file_note(self, desc, nhdr->n_descsz)))
+        FAIL;
+    }
+
+    p = desc + NOTE_ALIGN(nhdr->n_descsz);
+  }
+
+  // Fall back to the first thread if there is no process information.
+  if (self->pid == 0)
+    self->pid = tid;
+
+  SUCCESS;
+} /* _core__parse_notes */
+
+
+// ----------------------------------------------------------------------------
+// Segments are sorted by virtual address in core files.
+static core_segment_t *
+_core__find_segment(core_t * self, void * addr) {
+  register int lo = 0, hi = self->segment_count - 1;
+
+  while (lo <= hi) {
+    register int      mid = (lo + hi) >> 1;
+    core_segment_t  * seg = self->segments + mid;
+
+    if (addr < seg->vaddr)
+      hi = mid - 1;
+    else if (addr >= seg->vaddr + seg->mem_size)
+      lo = mid + 1;
+    else
+      return seg;
+  }
+
+  return NULL;
+} /* _core__find_segment */
+
+
+// ----------------------------------------------------------------------------
+// Serve memory that has not been dumped from the file that backed it. Anonymous
+// memory that has not been dumped reads as zeros.
+static ssize_t
+_core__read_from_file(core_t * self, void * addr, size_t len, void * buf) {
+  for (register int i = 0; i < self->map_count; i++) {
+    core_map_t * map = self->maps + i;
+    if (addr < map->lower || addr >= map->upper)
+      continue;
+
+    if (self->files[i] == NULL) {
+      self->files[i] = _map_file(map->path, &(self->file_sizes[i]));
+      if (self->files[i] == NULL) {
+        log_e("Cannot map %s, which is required to read the core file", map->path);
+        return -1;
+      }
+    }
+
+    size_t offset = map->offset + (addr - map->lower);
+    if (len > map->upper - addr)
+      len = map->upper - addr;
+
+    if (offset >= self->file_sizes[i])
+      memset(buf, 0, len);
+    else if (offset + len > self->file_sizes[i]) {
+      memcpy(buf, self->files[i] + offset, self->file_sizes[i] - offset);
+      memset(buf + self->file_sizes[i] - offset, 0, offset + len - self->file_sizes[i]);
+    }
+    else
+      memcpy(buf, self->files[i] + offset, len);
+
+    return len;
+  }
+
+  memset(buf, 0, len);
+
+  return len;
+} /* _core__read_from_file */
+
+
+// ---- PUBLIC ----------------------------------------------------------------
+
+// ----------------------------------------------------------------------------
+core_t *
+core_new(const char * path) {
+  size_t   size  = 0;
+  char   * image = _map_file(path, &size);
+  if (!isvalid(image)) {
+    log_e("Cannot map core file %s", path);
+    return NULL;
+  }
+
+  Elf64_Ehdr * ehdr = (Elf64_Ehdr *) image;
+  if (
+    size < sizeof(Elf64_Ehdr)
+  ||memcmp(ehdr->e_ident, ELFMAG, SELFMAG) != 0
+  ||ehdr->e_ident[EI_CLASS] != ELFCLASS64
+  ||ehdr->e_type != ET_CORE
+  ||ehdr->e_phoff + ehdr->e_phnum * ehdr->e_phentsize > size
+  ) {
+    log_e("%s is not a 64-bit ELF core file", path);
+    munmap(image, size);
+    return NULL;
+  }
+
+  core_t * self = (core_t *) calloc(1, sizeof(core_t));
+  if (!isvalid(self)) {
+    munmap(image, size);
+    return NULL;
+  }
+
+  self->image      = image;
+  self->image_size = size;
+
+  self->segments = (core_segment_t *) calloc(ehdr->e_phnum, sizeof(core_segment_t));
+  if (!isvalid(self->segments))
+    goto error;
+
+  for (register int i = 0; i < ehdr->e_phnum; i++) {
+    Elf64_Phdr * phdr = (Elf64_Phdr *) (image + ehdr->e_phoff + i * ehdr->e_phentsize);
+
+    if (phdr->p_offset > size)
+      continue;
+
+    switch (phdr->p_type) {
+    case PT_LOAD:
+      {
+        core_segment_t * seg = self->segments + self->segment_count++;
+
+        seg->vaddr     = (void *) phdr->p_vaddr;
+        seg->mem_size  = phdr->p_memsz;
+        seg->file_size = phdr->p_filesz;
+        seg->data      = image + phdr->p_offset;
+
+        if (phdr->p_offset + phdr->p_filesz > size) {
+          log_w("Core file segment @ %p is truncated", seg->vaddr);
+          seg->file_size = size - phdr->p_offset;
+        }
+      }
+      break;
+
+    case PT_NOTE:
+      if (
+        phdr->p_offset + phdr->p_filesz > size
+      ||fail(_core__parse_notes(self, image + phdr->p_offset, phdr->p_filesz))
+      ) goto error;
+    }
+  }
+
+  if (self->pid == 0 || self->map_count == 0) {
+    log_e("Core file %s has no process information", path);
+    goto error;
+  }
+
+  log_d(
+    "Core file of process %d: %d segments, %d file mappings",
+    self->pid, self->segment_count, self->map_count
+  );
+
+  return self;
+
+error:
+  core__destroy(self);
+  return NULL;
+} /* core_new */
+
+
+// ----------------------------------------------------------------------------
+ssize_t
+core__read(core_t * self, void * addr, ssize_t len, void * buf) {
+  ssize_t done = 0;
+
+  while (done < len) {
+    void           * curr = addr + done;
+    core_segment_t * seg  = _core__find_segment(self, curr);
+    if (!isvalid(seg))
+      return -1;
+
+    size_t  offset = curr - seg->vaddr;
+    ssize_t n      = len - done;
+
+    if (offset < seg->file_size) {
+      if ((size_t) n > seg->file_size - offset)
+        n = seg->file_size - offset;
+      memcpy(buf + done, seg->data + offset, n);
+    }
+    else {
+      if ((size_t) n > seg->mem_size - offset)
+        n = seg->mem_size - offset;
+      if ((n = _core__read_from_file(self, curr, n, buf + done)) == -1)
+        return -1;
+    }
+
+    done += n;
+  }
+
+  return done;
+} /* core__read */
+
+
+// ----------------------------------------------------------------------------
+void
+core__destroy(core_t * self) {
+  if (!isvalid(self))
+    return;
+
+  if (isvalid(self->files)) {
+    for (register int i = 0; i < self->map_count; i++)
+      if (isvalid(self->files[i]))
+        munmap(self->files[i], self->file_sizes[i]);
+    free(self->files);
+  }
+
+  sfree(self->file_sizes);
+  sfree(self->maps);
+  sfree(self->segments);
+
+  munmap(self->image, self->image_size);
+
+  free(self);
+} /* core__destroy */
+
+#endif
@@ -0,0 +1,103 @@
+// This file is part of "austin" which is released under GPL.
+//
+// See file LICENCE or go to http://www.gnu.org/licenses/ for full license
+// details.
+//
+// Austin is a Python frame stack sampler for CPython.
+//
+// Copyright (c) 2018 Gabriele N. Tornetta <phoenix1987@gmail.com>.
+// All rights reserved.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef CORE_H
+#define CORE_H
+
+
+#include <sys/types.h>
+
+
+// A memory mapping of the dumped process, as recorded in the NT_FILE note of
+// the core file.
+typedef struct {
+  void   * lower;
+  void   * upper;
+  off_t    offset;  // Offset within the mapped file.
+  char   * path;
+} core_map_t;
+
+
+// A loadable segment of the core file.
+typedef struct {
+  void   * vaddr;
+  size_t   mem_size;
+  size_t   file_size;  // The part that is actually dumped in the core file.
+  char   * data;       // Pointer into the core file mapping.
+} core_segment_t;
+
+
+typedef struct {
+  char           * image;
+  size_t           image_size;
+  pid_t            pid;
+
+  core_segment_t * segments;
+  int              segment_count;
+
+  core_map_t     * maps;
+  int              map_count;
+
+  // Mappings of the files that back the memory mappings, in the same order
+  // as maps. They are created on demand to serve pages that are not dumped.
+  char          ** files;
+  size_t         * file_sizes;
+} core_t;
+
+
+/**
+ * Map a core file in memory and index its segments and notes.
+ *
+ * @param  char *  the path of the core file.
+ *
+ * @return a pointer to the new core object, or NULL on failure.
+ */
+core_t *
+core_new(const char *);
+
+
+/**
+ * Copy memory of the dumped process. Dumped pages are copied straight out of
+ * the core file mapping, while pages that were left out of the dump are read
+ * from the file that backed them, if any.
+ *
+ * @param  core_t *  self.
+ * @param  void *    the address in the dumped process.
+ * @param  ssize_t   the number of bytes to copy.
+ * @param  void *    the destination buffer.
+ *
+ * @return the number of bytes copied, or -1 if the range is not available.
+ */
+ssize_t
+core__read(core_t *, void *, ssize_t, void *);
+
+
+/**
+ * Unmap the core file and all the backing files and free the core object.
+ *
+ * @param  core_t *  self.
+ */
+void
+core__destroy(core_t *);
+
+
+#endif
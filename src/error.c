@@ -29,7 +29,7 @@
 #include "platform.h"
 
 
-#define MAXERROR              (5 << 3)
+#define MAXERROR              (6 << 3)
 
 const char * _error_msg_tab[MAXERROR] = {
   // generic error messages
@@ -39,8 +39,8 @@ const char * _error_msg_tab[MAXERROR] = {
   "Cannot determine Python version",
   "Cannot redirect STDOUT to " NULL_DEVICE,
   "No command nor valid PID",
-  NULL,
-  NULL,
+  "Cannot read the cgroup",
+  "Cannot open an output sink",
 
   // py_code_t
   "Failed to retrieve PyCodeObject",
@@ -81,6 +81,16 @@ const char * _error_msg_tab[MAXERROR] = {
   "Permission denied. Try with elevated privileges.",
   "No such process.",
   NULL,
+
+  // aggregator_t
+  "Cannot start the aggregator",
+  "Cannot open the marker channel",
+  NULL,
+  NULL,
+  NULL,
+  NULL,
+  NULL,
+  NULL,
 };
 
 
@@ -92,8 +102,8 @@ const int _fatal_error_tab[MAXERROR] = {
   1,
   0,
   1,
-  0,
-  0,
+  1,
+  1,
 
   // py_code_t
   0,
@@ -134,6 +144,16 @@ const int _fatal_error_tab[MAXERROR] = {
   1,
   1,
   0,
+
+  // aggregator_t
+  1,
+  1,
+  0,
+  0,
+  0,
+  0,
+  0,
+  0,
 };
 
 
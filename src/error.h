@@ -35,6 +35,8 @@
 #define ENOVERSION            3
 #define ENULLDEV              4
 #define ECMDLINE              5
+#define ECGROUP               6
+#define ESINK                 7
 
 // py_code_t
 #define ECODE                 ((1 << 3) + 0)
@@ -65,6 +67,10 @@
 #define EPROCPERM             ((4 << 3) + 5)
 #define EPROCNPID             ((4 << 3) + 6)
 
+// aggregator_t
+#define EAGGREGATOR           ((5 << 3) + 0)
+#define EMARKERS              ((5 << 3) + 1)
+
 
 typedef int error_t;
 
@@ -22,6 +22,7 @@
 
 #ifdef PY_PROC_C
 
+#include <dirent.h>
 #include <elf.h>
 #include <fcntl.h>
 #include <pthread.h>
@@ -36,6 +37,7 @@
 #include "../dict.h"
 #include "../hints.h"
 #include "../py_proc.h"
+#include "../py_thread.h"
 
 
 #define CHECK_HEAP
@@ -53,16 +55,77 @@
 #define PROC_REF                        (self->pid)
 
 
+// Number of pid_t items to scan in the remote pthread structure when looking
+// for the native thread ID field.
+#define PTHREAD_BUFFER_ITEMS          256
+
+// Number of samples between sweeps of the task table.
+#define TASK_SWEEP_INTERVAL           256
+
+// Size of the buffers used to read the content of the task stat and status
+// files.
+#define TASK_STAT_BUFFER_SIZE         1024
+#define TASK_STATUS_BUFFER_SIZE       4096
+
+// Size of the buffer used to read the content of the smaps_rollup file.
+#define SMAPS_BUFFER_SIZE             4096
+
+// Whether any task metrics have been requested.
+#define TASK_METRICS                  (pargs.faults || pargs.ctx_switches || pargs.io || pargs.numa)
+
+// Maximum number of CPUs in the CPU-to-NUMA-node map.
+#define MAX_CPUS                      4096
+
+
 #define _py_proc__get_elf_type(self, vaddr, dt) /* as */ (py_proc__memcpy(self, vaddr, sizeof(dt), &dt))
 
 // Get the offset of the ith section header
 #define ELF_SH_OFF(ehdr, i) /* as */ (ehdr.e_shoff + i * ehdr.e_shentsize)
 
 
+// Per-thread (task) state, used to compute task metric deltas between
+// samples. The stat, status and io files are kept open for as long as the task
+// is alive.
+typedef struct {
+  pid_t        tid;
+  int          stat_fd;
+  int          status_fd;
+  int          io_fd;
+  int          stale;     // Set when the baselines need to be re-read.
+  unsigned int tick;      // The last tick at which the task was seen.
+  ustat_t      minflt;
+  ustat_t      majflt;
+  ustat_t      vcsw;
+  ustat_t      ivcsw;
+  ustat_t      rchar;
+  ustat_t      wchar;
+} proc_task_t;
+
+
 struct _proc_extra_info {
-  unsigned int page_size;
-  char         statm_file[24];
-  pthread_t    wait_thread_id;
+  unsigned int  page_size;
+  char          statm_file[24];
+  pthread_t     wait_thread_id;
+
+  // The smaps_rollup file is kept open when it is used as the memory source,
+  // or -1 otherwise.
+  int             smaps_fd;
+  mem_breakdown_t smaps_curr;
+  mem_breakdown_t smaps_last;
+
+  // Offset of the native TID field within the remote pthread structure, in
+  // units of pid_t. Zero until inferred.
+  int           tid_offset;
+  unsigned int  tid_offset_tick;
+
+  // The core file, when the process only survives as one.
+  core_t      * core;
+
+  proc_task_t * tasks;
+  int           task_count;
+  int           task_size;
+  int           task_hint;
+  unsigned int  tick;
 };
 
 
@@ -260,13 +323,16 @@ _py_proc__analyze_elf32(py_proc_t * self) {
 // ----------------------------------------------------------------------------
 static int
 _py_proc__analyze_elf(py_proc_t * self) {
-  Elf64_Ehdr ehdr = ehdr_v.v64;
   log_t("Analysing ELF");
   if (_py_proc__get_elf_type(self, self->map.elf.base, ehdr_v)) {
     log_ie("Cannot read ELF header");
     FAIL;
   }
 
+  // Only look at the header once it has been read, or we might be checking the
+  // one from a previous attempt.
+  Elf64_Ehdr ehdr = ehdr_v.v64;
+
   if (ehdr.e_shoff == 0 || ehdr.e_shnum < 2 || memcmp(ehdr.e_ident, ELFMAG, SELFMAG)) {
     log_e("Invalid ELF format");
     FAIL;
@@ -312,6 +378,33 @@ _file_size(char * file) {
 }
 
 
+// ----------------------------------------------------------------------------
+// Consider the given mapping of a Python object file as a candidate binary or
+// library.
+static void
+_py_proc__add_object_map(py_proc_t * self, ssize_t lower, ssize_t upper, char * pathname) {
+  // Check if it is an executable. Only bother if the size is above the
+  // MB threshold. Anything smaller is probably not a useful binary.
+  ssize_t file_size = _file_size(pathname);
+  if (_elf_is_executable(pathname)) {
+    if (self->bin_path != NULL || (file_size < (1 << 20)))
+      return;
+
+    log_d("Candidate binary: %s (size %d KB)", pathname, file_size >> 10);
+    self->bin_path = strndup(pathname, strlen(pathname));
+  } else {
+    if (self->bin_path != NULL || self->lib_path != NULL || (file_size < (1 << 20)))
+      return;
+
+    log_d("Candidate library: %s (size %d KB)", pathname, file_size >> 10);
+    self->lib_path = strndup(pathname, strlen(pathname));
+  }
+
+  self->map.elf.base = (void *) lower;
+  self->map.elf.size = upper - lower;
+} /* _py_proc__add_object_map */
+
+
 // ----------------------------------------------------------------------------
 static int
 _py_proc__parse_maps_file(py_proc_t * self) {
@@ -371,38 +464,13 @@ _py_proc__parse_maps_file(py_proc_t * self) {
           continue;
         }
 
-        if (strstr(line, "python") == NULL)
         // NOTE: The python binary might have a name that doesn't contain python
         //       but would still be valid. In case of future issues, this
         //       should be changed so that the binary on the first line is
         //       checked for, e.g., knownw symbols to determine whether it is a
         //       valid binary that Austin can handle.
-          continue;
-
-        // Check if it is an executable. Only bother if the size is above the
-        // MB threshold. Anything smaller is probably not a useful binary.
-        ssize_t file_size = _file_size(pathname);
-        if (_elf_is_executable(pathname)) {
-          if (self->bin_path != NULL || (file_size < (1 << 20)))
-            continue;
-
-          log_d("Candidate binary: %s (size %d KB)", pathname, file_size >> 10);
-          self->bin_path = strndup(pathname, strlen(pathname));
-
-          self->map.elf.base = (void *) lower;
-          self->map.elf.size = upper - lower;
-
-          continue;
-        } else {
-          if (self->bin_path != NULL || self->lib_path != NULL || (file_size < (1 << 20)))
-            continue;
-
-          log_d("Candidate library: %s (size %d KB)", pathname, file_size >> 10);
-          self->lib_path = strndup(pathname, strlen(pathname));
-
-          self->map.elf.base = (void *) lower;
-          self->map.elf.size = upper - lower;
-        }
+        if (strstr(line, "python") != NULL)
+          _py_proc__add_object_map(self, lower, upper, pathname);
       }
     }
 
@@ -419,9 +487,119 @@ _py_proc__parse_maps_file(py_proc_t * self) {
 } /* _py_proc__parse_maps_file */
 
 
+// ----------------------------------------------------------------------------
+// Same as _py_proc__parse_maps_file, but for a process that only survives as a
+// core file. The file mappings come from the NT_FILE note, which has no record
+// of the heap, so this is taken to be the first anonymous segment past the end
+// of the executable.
+static int
+_py_proc__parse_core_maps(py_proc_t * self) {
+  core_t * core    = self->extra->core;
+  char   * exe     = core->maps[0].path;
+  void   * exe_end = NULL;
+
+  self->min_raddr = (void *) -1;
+  self->max_raddr = NULL;
+
+  sfree(self->bin_path);
+  sfree(self->lib_path);
+
+  for (register int i = 0; i < core->segment_count; i++) {
+    core_segment_t * seg = core->segments + i;
+    if ((ssize_t) seg->vaddr < 0)
+      continue;  // Skip the kernel gate area, like [vsyscall].
+    if (seg->vaddr < self->min_raddr)
+      self->min_raddr = seg->vaddr;
+    if (seg->vaddr + seg->mem_size > self->max_raddr)
+      self->max_raddr = seg->vaddr + seg->mem_size;
+  }
+
+  for (register int i = 0; i < core->map_count; i++) {
+    core_map_t * map = core->maps + i;
+
+    if (strcmp(map->path, exe) == 0 && map->upper > exe_end)
+      exe_end = map->upper;
+
+    if (strstr(map->path, "python") != NULL)
+      _py_proc__add_object_map(self, (ssize_t) map->lower, (ssize_t) map->upper, map->path);
+  }
+
+  for (register int i = 0; i < core->segment_count; i++) {
+    core_segment_t * seg = core->segments + i;
+    if (seg->vaddr <= exe_end)
+      continue;
+
+    register int j;
+    for (j = 0; j < core->map_count; j++)
+      if (seg->vaddr >= core->maps[j].lower && seg->vaddr < core->maps[j].upper)
+        break;
+    if (j < core->map_count)
+      continue;
+
+    self->map.heap.base = seg->vaddr;
+    self->map.heap.size = seg->mem_size;
+    log_d("HEAP bounds %p-%p", seg->vaddr, seg->vaddr + seg->mem_size);
+    break;
+  }
+
+  return self->bin_path == NULL && self->lib_path == NULL;
+} /* _py_proc__parse_core_maps */
+
+
+// ----------------------------------------------------------------------------
+// Get the value, in bytes, of the given field of the smaps_rollup file, or 0 if
+// the field is not available.
+static ssize_t
+_smaps__get_field(char * buffer, const char * field) {
+  char * p = strstr(buffer, field);
+  return isvalid(p) ? strtol(p + strlen(field), NULL, 10) << 10 : 0;
+}
+
+
+// ----------------------------------------------------------------------------
+// Read the proportional set size from smaps_rollup and keep its breakdown.
+static ssize_t
+_py_proc__get_smaps_pss(py_proc_t * self) {
+  char    buffer[SMAPS_BUFFER_SIZE];
+  ssize_t len = pread(self->extra->smaps_fd, buffer, sizeof(buffer) - 1, 0);
+  if (len <= 0) {
+    set_error(EPROCVM);
+    return -1;
+  }
+  buffer[len] = '\0';
+
+  self->extra->smaps_curr.anon  = _smaps__get_field(buffer, "\nPss_Anon:");
+  self->extra->smaps_curr.file  = _smaps__get_field(buffer, "\nPss_File:");
+  self->extra->smaps_curr.shmem = _smaps__get_field(buffer, "\nPss_Shmem:");
+
+  return _smaps__get_field(buffer, "\nPss:");
+} /* _py_proc__get_smaps_pss */
+
+
+// ----------------------------------------------------------------------------
+// Get the breakdown of the memory delta since the last call. The breakdown is
+// that of the last memory reading. Pass NULL to just set a new baseline.
+static void
+_py_proc__get_smaps_delta(py_proc_t * self, mem_breakdown_t * delta) {
+  mem_breakdown_t * curr = &(self->extra->smaps_curr);
+  mem_breakdown_t * last = &(self->extra->smaps_last);
+
+  if (isvalid(delta)) {
+    delta->anon  = curr->anon  - last->anon;
+    delta->file  = curr->file  - last->file;
+    delta->shmem = curr->shmem - last->shmem;
+  }
+
+  *last = *curr;
+} /* _py_proc__get_smaps_delta */
+
+
 // ----------------------------------------------------------------------------
 static ssize_t
 _py_proc__get_resident_memory(py_proc_t * self) {
+  if (self->extra->smaps_fd >= 0)
+    return _py_proc__get_smaps_pss(self);
+
   FILE * statm = fopen(self->extra->statm_file, "rb");
   if (statm == NULL) {
     set_error(EPROCVM);
@@ -438,23 +616,468 @@ _py_proc__get_resident_memory(py_proc_t * self) {
 } /* _py_proc__get_resident_memory */
 
 
+// ---- Task metrics ----------------------------------------------------------
+
+// ----------------------------------------------------------------------------
+// Infer the offset of the native TID field within the remote pthread structure
+// pointed to by the thread ID of the given thread. This only works for the
+// main thread, whose native TID is the PID. The smallest matching offset is
+// taken over all the threads as older versions of glibc also store the PID
+// right after the TID in every thread structure.
+static void
+_py_proc__infer_tid_offset(py_proc_t * self, py_thread_t * py_thread) {
+  pid_t buffer[PTHREAD_BUFFER_ITEMS];
+
+  if (py_thread->tid == (uintptr_t) py_thread->raddr.addr)
+    return;  // No pthread structure to look at.
+
+  if (fail(py_proc__memcpy(self, (void *) py_thread->tid, sizeof(buffer), buffer)))
+    return;
+
+  int limit = self->extra->tid_offset ? self->extra->tid_offset : PTHREAD_BUFFER_ITEMS;
+  for (register int i = 1; i < limit; i++) {
+    if (buffer[i] == self->pid) {
+      self->extra->tid_offset      = i;
+      self->extra->tid_offset_tick = self->extra->tick;
+      log_d("Native TID field offset: %d", i * sizeof(pid_t));
+      return;
+    }
+  }
+} /* _py_proc__infer_tid_offset */
+
+
+// ----------------------------------------------------------------------------
+static pid_t
+_py_proc__get_native_tid(py_proc_t * self, py_thread_t * py_thread) {
+  pid_t tid;
+
+  if (
+    self->extra->tid_offset == 0 ||
+    py_thread->tid == (uintptr_t) py_thread->raddr.addr ||
+    fail(py_proc__get_type(
+      self, ((pid_t *) py_thread->tid) + self->extra->tid_offset, tid
+    ))
+  ) return 0;
+
+  return tid;
+} /* _py_proc__get_native_tid */
+
+
+// ----------------------------------------------------------------------------
+static void
+_proc_task__close(proc_task_t * task) {
+  if (task->stat_fd >= 0)
+    close(task->stat_fd);
+  if (task->status_fd >= 0)
+    close(task->status_fd);
+  if (task->io_fd >= 0)
+    close(task->io_fd);
+  task->stat_fd = task->status_fd = task->io_fd = -1;
+}
+
+
 // ----------------------------------------------------------------------------
 static int
-_py_proc__init(py_proc_t * self) {
+_proc_task__open(proc_task_t * task, pid_t pid, pid_t tid) {
+  char path[48];
+
+  task->stat_fd = task->status_fd = task->io_fd = -1;
+
+  if (pargs.faults || pargs.numa) {
+    sprintf(path, "/proc/%d/task/%d/stat", pid, tid);
+    if ((task->stat_fd = open(path, O_RDONLY)) < 0)
+      FAIL;
+  }
+
+  if (pargs.ctx_switches) {
+    sprintf(path, "/proc/%d/task/%d/status", pid, tid);
+    if ((task->status_fd = open(path, O_RDONLY)) < 0) {
+      _proc_task__close(task);
+      FAIL;
+    }
+  }
+
+  if (pargs.io) {
+    sprintf(path, "/proc/%d/task/%d/io", pid, tid);
+    if ((task->io_fd = open(path, O_RDONLY)) < 0) {
+      _proc_task__close(task);
+      FAIL;
+    }
+  }
+
+  task->tid   = tid;
+  task->stale = TRUE;
+
+  SUCCESS;
+}
+
+
+// ----------------------------------------------------------------------------
+// Find the task with the given TID, or create a new one if not found. The
+// lookup starts from the slot after the last one that was hit since threads
+// are visited in the same order at every sample.
+static proc_task_t *
+_py_proc__get_task(py_proc_t * self, pid_t tid) {
+  proc_extra_info * extra = self->extra;
+
+  for (register int i = 0; i < extra->task_count; i++) {
+    register int j = (extra->task_hint + i) % extra->task_count;
+    if (extra->tasks[j].tid == tid) {
+      extra->task_hint = j + 1;
+      return &(extra->tasks[j]);
+    }
+  }
+
+  if (extra->task_count == extra->task_size) {
+    int           size  = extra->task_size ? extra->task_size << 1 : 16;
+    proc_task_t * tasks = (proc_task_t *) realloc(extra->tasks, size * sizeof(proc_task_t));
+    if (!isvalid(tasks))
+      return NULL;
+    extra->tasks     = tasks;
+    extra->task_size = size;
+  }
+
+  proc_task_t * task = &(extra->tasks[extra->task_count]);
+  if (fail(_proc_task__open(task, self->pid, tid))) {
+    log_d("Cannot open proc files for task %d", tid);
+    return NULL;
+  }
+
+  extra->task_count++;
+
+  log_t("New task %d for process %d", tid, self->pid);
+
+  return task;
+} /* _py_proc__get_task */
+
+
+// ----------------------------------------------------------------------------
+// Close the tasks that have not been seen for a whole sweep interval.
+static void
+_py_proc__sweep_tasks(py_proc_t * self) {
+  proc_extra_info * extra = self->extra;
+
+  for (register int i = 0; i < extra->task_count; /* i++ */) {
+    if (extra->tick - extra->tasks[i].tick >= TASK_SWEEP_INTERVAL) {
+      log_t("Task %d is gone", extra->tasks[i].tid);
+      _proc_task__close(&(extra->tasks[i]));
+      extra->tasks[i] = extra->tasks[--extra->task_count];
+    }
+    else i++;
+  }
+} /* _py_proc__sweep_tasks */
+
+
+// ----------------------------------------------------------------------------
+// Read the stat file of the task and parse the fields of interest. Fields are
+// counted from 1, as in proc(5), and must be given in increasing order. The
+// array of fields is terminated by 0.
+static int
+_proc_task__read_stat(proc_task_t * task, const int * fields, ustat_t * values) {
+  char    buffer[TASK_STAT_BUFFER_SIZE];
+  ssize_t len = pread(task->stat_fd, buffer, sizeof(buffer) - 1, 0);
+  if (len <= 0)
+    FAIL;
+  buffer[len] = '\0';
+
+  // The command name might contain spaces so we start from the last ')'.
+  char * p = strrchr(buffer, ')');
+  if (!isvalid(p))
+    FAIL;
+
+  for (register int field = 2; *fields; values++, fields++) {
+    while (field < *fields) {
+      if (!isvalid(p = strchr(p + 1, ' ')))
+        FAIL;
+      field++;
+    }
+    *values = strtoul(p + 1, NULL, 10);
+  }
+
+  SUCCESS;
+} /* _proc_task__read_stat */
+
+
+// ----------------------------------------------------------------------------
+// Read the number of voluntary and involuntary context switches from the
+// status file of the task. These are the last two entries of the file.
+static int
+_proc_task__read_ctx_switches(proc_task_t * task, ustat_t * vcsw, ustat_t * ivcsw) {
+  char    buffer[TASK_STATUS_BUFFER_SIZE];
+  ssize_t len = pread(task->status_fd, buffer, sizeof(buffer) - 1, 0);
+  if (len <= 0)
+    FAIL;
+  buffer[len] = '\0';
+
+  // The voluntary entry comes first, so this is not matched by the involuntary
+  // one.
+  char * p = strstr(buffer, "voluntary_ctxt_switches:");
+  if (!isvalid(p))
+    FAIL;
+  *vcsw = strtoul(p + sizeof("voluntary_ctxt_switches:") - 1, &p, 10);
+
+  if (!isvalid(p = strstr(p, "nonvoluntary_ctxt_switches:")))
+    FAIL;
+  *ivcsw = strtoul(p + sizeof("nonvoluntary_ctxt_switches:") - 1, NULL, 10);
+
+  SUCCESS;
+} /* _proc_task__read_ctx_switches */
+
+
+// ----------------------------------------------------------------------------
+// Read the number of bytes read and written by the task. These are the first
+// two entries of the io file.
+static int
+_proc_task__read_io(proc_task_t * task, ustat_t * rchar, ustat_t * wchar) {
+  char    buffer[TASK_STAT_BUFFER_SIZE];
+  ssize_t len = pread(task->io_fd, buffer, sizeof(buffer) - 1, 0);
+  if (len <= 0)
+    FAIL;
+  buffer[len] = '\0';
+
+  if (sscanf(buffer, "rchar: %lu\nwchar: %lu", rchar, wchar) != 2)
+    FAIL;
+
+  SUCCESS;
+} /* _proc_task__read_io */
+
+
+// ----------------------------------------------------------------------------
+// CPU-to-NUMA-node map, built on first use from the nodeN entries in the sysfs
+// CPU directories. CPUs that do not appear there are reported on node 0.
+static short _cpu_node[MAX_CPUS];
+static int   _cpu_node_init = FALSE;
+
+static void
+_cpu_node__init(void) {
+  DIR           * cpu_dir;
+  DIR           * node_dir;
+  struct dirent * cpu_ent;
+  struct dirent * node_ent;
+  char            path[64];
+  int             cpu, node;
+
+  _cpu_node_init = TRUE;
+
+  if (!isvalid(cpu_dir = opendir("/sys/devices/system/cpu"))) {
+    log_w("Cannot read the CPU-to-NUMA-node map");
+    return;
+  }
+
+  while (isvalid(cpu_ent = readdir(cpu_dir))) {
+    if (sscanf(cpu_ent->d_name, "cpu%d", &cpu) != 1 || cpu < 0 || cpu >= MAX_CPUS)
+      continue;
+
+    sprintf(path, "/sys/devices/system/cpu/cpu%d", cpu);
+    if (!isvalid(node_dir = opendir(path)))
+      continue;
+
+    while (isvalid(node_ent = readdir(node_dir))) {
+      if (sscanf(node_ent->d_name, "node%d", &node) == 1) {
+        _cpu_node[cpu] = node;
+        break;
+      }
+    }
+    closedir(node_dir);
+  }
+
+  closedir(cpu_dir);
+} /* _cpu_node__init */
+
+
+// ----------------------------------------------------------------------------
+static inline int
+_cpu__get_node(int cpu) {
+  if (!_cpu_node_init)
+    _cpu_node__init();
+
+  return cpu >= 0 && cpu < MAX_CPUS ? _cpu_node[cpu] : 0;
+}
+
+
+static const int _task_stat_fields[] = {10, 12, 39, 0};  // minflt, majflt, processor
+
+
+// ----------------------------------------------------------------------------
+// Collect the task metrics for the given thread as deltas since the previous
+// sample of the same thread.
+static void
+_py_proc__sample_task(py_proc_t * self, py_thread_t * py_thread) {
+  ustat_t values[3];
+  ustat_t vcsw, ivcsw;
+  ustat_t rchar, wchar;
+
+  py_thread->minflt = py_thread->majflt = 0;
+  py_thread->vcsw   = py_thread->ivcsw  = 0;
+  py_thread->rchar  = py_thread->wchar  = 0;
+  py_thread->cpu    = py_thread->node   = -1;
+
+  // Look at all the threads in the sample where the offset is first found.
+  if (self->extra->tid_offset == 0 || self->extra->tid_offset_tick == self->extra->tick)
+    _py_proc__infer_tid_offset(self, py_thread);
+
+  pid_t tid = _py_proc__get_native_tid(self, py_thread);
+  if (tid <= 0)
+    return;
+
+  proc_task_t * task = _py_proc__get_task(self, tid);
+  if (!isvalid(task))
+    return;
+
+  task->tick = self->extra->tick;
+
   if (
-   !isvalid(self)
-  ||fail   (_py_proc__parse_maps_file(self))
-  ||fail   (_py_proc__analyze_elf(self))
-  ) FAIL;
+    ((pargs.faults || pargs.numa) && fail(_proc_task__read_stat(task, _task_stat_fields, values)))
+  ||(pargs.ctx_switches && fail(_proc_task__read_ctx_switches(task, &vcsw, &ivcsw)))
+  ||(pargs.io && fail(_proc_task__read_io(task, &rchar, &wchar)))
+  ) {
+    log_d("Cannot read proc files for task %d", tid);
+    task->stale = TRUE;
+    return;
+  }
 
+  if (pargs.faults) {
+    if (!task->stale) {
+      py_thread->minflt = values[0] - task->minflt;
+      py_thread->majflt = values[1] - task->majflt;
+    }
+    task->minflt = values[0];
+    task->majflt = values[1];
+  }
+
+  if (pargs.numa) {
+    py_thread->cpu  = values[2];
+    py_thread->node = _cpu__get_node(values[2]);
+  }
+
+  if (pargs.ctx_switches) {
+    if (!task->stale) {
+      py_thread->vcsw  = vcsw  - task->vcsw;
+      py_thread->ivcsw = ivcsw - task->ivcsw;
+    }
+    task->vcsw  = vcsw;
+    task->ivcsw = ivcsw;
+  }
+
+  if (pargs.io) {
+    if (!task->stale) {
+      py_thread->rchar = rchar - task->rchar;
+      py_thread->wchar = wchar - task->wchar;
+    }
+    task->rchar = rchar;
+    task->wchar = wchar;
+  }
+
+  task->stale = FALSE;
+} /* _py_proc__sample_task */
+
+
+// ----------------------------------------------------------------------------
+static void
+_py_proc__tick_tasks(py_proc_t * self) {
+  if (++self->extra->tick % TASK_SWEEP_INTERVAL == 0)
+    _py_proc__sweep_tasks(self);
+} /* _py_proc__tick_tasks */
+
+
+// ----------------------------------------------------------------------------
+static void
+_py_proc__resume_tasks(py_proc_t * self) {
+  for (register int i = 0; i < self->extra->task_count; i++)
+    self->extra->tasks[i].stale = TRUE;
+} /* _py_proc__resume_tasks */
+
+
+// ----------------------------------------------------------------------------
+static void
+_py_proc__destroy_tasks(py_proc_t * self) {
+  for (register int i = 0; i < self->extra->task_count; i++)
+    _proc_task__close(&(self->extra->tasks[i]));
+
+  sfree(self->extra->tasks);
+  self->extra->task_count = self->extra->task_size = 0;
+} /* _py_proc__destroy_tasks */
+
+
+// ----------------------------------------------------------------------------
+// Choose how to read the memory of the process. A read from the NULL address
+// fails with EFAULT when process_vm_readv is usable. If the system call is
+// blocked, e.g. by a seccomp profile or by a sandbox like gVisor, fall back to
+// reading from /proc/<pid>/mem.
+static void
+_py_proc__select_mem_backend(py_proc_t * self) {
+  if (_proc_mem_count && proc_mem__lookup(self->pid) >= 0)
+    return;
+
+  if (!pargs.proc_mem) {
+    char         byte;
+    struct iovec local  = {&byte, 1};
+    struct iovec remote = {NULL,  1};
+
+    if (process_vm_readv(self->pid, &local, 1, &remote, 1, 0) != -1)
+      return;
+    if (errno != ENOSYS && errno != EPERM)
+      return;
+
+    log_w("process_vm_readv not available (errno %d). Using /proc/%d/mem", errno, self->pid);
+  }
+
+  if (fail(proc_mem__open(self->pid)))
+    log_e("Cannot open /proc/%d/mem", self->pid);
+  else
+    log_d("Reading memory of process %d from /proc/%d/mem", self->pid, self->pid);
+} /* _py_proc__select_mem_backend */
+
+
+// ----------------------------------------------------------------------------
+// Set up the sources of the memory metrics.
+static int
+_py_proc__init_metrics(py_proc_t * self) {
   self->extra->page_size = getpagesize();
   log_d("Page size: %ld", self->extra->page_size);
 
   sprintf(self->extra->statm_file, "/proc/%d/statm", self->pid);
 
+  // The fallback is per process, so that the output keeps the same columns.
+  // The breakdown of a process without smaps_rollup is then reported as 0.
+  if (pargs.smaps && self->extra->smaps_fd < 0) {
+    char smaps_file[32];
+    sprintf(smaps_file, "/proc/%d/smaps_rollup", self->pid);
+    if ((self->extra->smaps_fd = open(smaps_file, O_RDONLY)) < 0)
+      log_w("Cannot open %s. Falling back to the resident set size", smaps_file);
+  }
+
   self->last_resident_memory = _py_proc__get_resident_memory(self);
+  if (pargs.smaps)
+    _py_proc__get_smaps_delta(self, NULL);
 
   SUCCESS;
+} /* _py_proc__init_metrics */
+
+
+// ----------------------------------------------------------------------------
+static int
+_py_proc__init(py_proc_t * self) {
+  if (!isvalid(self))
+    FAIL;
+
+  if (isvalid(self->extra->core)) {
+    if (
+     fail(_py_proc__parse_core_maps(self))
+    ||fail(_py_proc__analyze_elf(self))
+    ) FAIL;
+
+    SUCCESS;
+  }
+
+  _py_proc__select_mem_backend(self);
+
+  if (
+   fail(_py_proc__parse_maps_file(self))
+  ||fail(_py_proc__analyze_elf(self))
+  ) FAIL;
+
+  return _py_proc__init_metrics(self);
 } /* _py_proc__init */
 
 
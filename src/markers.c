@@ -0,0 +1,171 @@
+// This file is part of "austin" which is released under GPL.
+//
+// See file LICENCE or go to http://www.gnu.org/licenses/ for full license
+// details.
+//
+// Austin is a Python frame stack sampler for CPython.
+//
+// Copyright (c) 2018 Gabriele N. Tornetta <phoenix1987@gmail.com>.
+// All rights reserved.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "platform.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#if defined PL_UNIX
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "argparse.h"
+#include "error.h"
+#include "hints.h"
+#include "logging.h"
+#include "sink.h"
+#include "stats.h"
+
+#include "markers.h"
+
+
+#define MARKERS_POLL_INTERVAL          10000  // Read the channel every 10ms.
+
+
+static int     _fd        = -1;
+static int     _created   = FALSE;
+static ctime_t _poll_time = 0;
+
+// The label being read, which might come in more than one read.
+static char    _label[MAX_MARKER_LEN + 1];
+static size_t  _label_len = 0;
+static int     _truncated = FALSE;
+
+
+// ---- PRIVATE ---------------------------------------------------------------
+
+// ----------------------------------------------------------------------------
+static void
+_markers__add(const char * data, size_t len) {
+  for (register size_t i = 0; i < len; i++) {
+    if (data[i] == '\n') {
+      _label[_label_len] = '\0';
+      if (_label_len > 0) {
+        if (_truncated)
+          log_w("Marker label truncated to %d characters", MAX_MARKER_LEN);
+        sinks_marker(_label);
+      }
+      _label_len = 0;
+      _truncated = FALSE;
+    }
+    else if (data[i] == '\r')
+      continue;
+    else if (_label_len < MAX_MARKER_LEN)
+      _label[_label_len++] = data[i];
+    else
+      _truncated = TRUE;
+  }
+} /* _markers__add */
+
+
+// ---- PUBLIC ----------------------------------------------------------------
+
+// ----------------------------------------------------------------------------
+int
+markers_open(void) {
+  if (pargs.markers == NULL)
+    SUCCESS;
+
+  #if defined PL_UNIX
+  struct stat st;
+
+  if (stat(pargs.markers, &st) != 0) {
+    if (mkfifo(pargs.markers, 0600) != 0) {
+      log_e("Cannot create the marker channel %s", pargs.markers);
+      goto error;
+    }
+    _created = TRUE;
+  }
+  else if (!S_ISFIFO(st.st_mode)) {
+    log_e("The marker channel %s is not a FIFO", pargs.markers);
+    goto error;
+  }
+
+  // Without blocking, the FIFO can be opened before any writer comes along,
+  // and writers can come and go.
+  if ((_fd = open(pargs.markers, O_RDONLY | O_NONBLOCK)) < 0) {
+    log_e("Cannot open the marker channel %s", pargs.markers);
+    goto error;
+  }
+
+  log_i("Marker channel: %s", pargs.markers);
+
+  SUCCESS;
+
+error:
+  markers_close();
+  set_error(EMARKERS);
+  FAIL;
+
+  #else
+  log_e("Marker channels are not supported on this platform");
+  set_error(EMARKERS);
+  FAIL;
+  #endif
+} /* markers_open */
+
+
+// ----------------------------------------------------------------------------
+void
+markers_poll(void) {
+  #if defined PL_UNIX
+  char    buffer[MAX_MARKER_LEN + 1];
+  ssize_t n;
+
+  if (_fd < 0)
+    return;
+
+  ctime_t now = gettime();
+  if (now - _poll_time < MARKERS_POLL_INTERVAL)
+    return;
+  _poll_time = now;
+
+  while ((n = read(_fd, buffer, sizeof(buffer))) > 0 || (n < 0 && errno == EINTR))
+    if (n > 0)
+      _markers__add(buffer, n);
+  #endif
+} /* markers_poll */
+
+
+// ----------------------------------------------------------------------------
+void
+markers_close(void) {
+  #if defined PL_UNIX
+  if (_fd >= 0) {
+    // Do not lose the markers that are still in the channel.
+    _poll_time = 0;
+    markers_poll();
+
+    close(_fd);
+    _fd = -1;
+  }
+
+  if (_created) {
+    unlink(pargs.markers);
+    _created = FALSE;
+  }
+  #endif
+} /* markers_close */
@@ -0,0 +1,58 @@
+// This file is part of "austin" which is released under GPL.
+//
+// See file LICENCE or go to http://www.gnu.org/licenses/ for full license
+// details.
+//
+// Austin is a Python frame stack sampler for CPython.
+//
+// Copyright (c) 2018 Gabriele N. Tornetta <phoenix1987@gmail.com>.
+// All rights reserved.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef MARKERS_H
+#define MARKERS_H
+
+
+// The longest label of a marker. Longer labels are truncated.
+#define MAX_MARKER_LEN                 200
+
+
+/**
+ * Open the marker channel given on the command line, if any. This is a FIFO,
+ * which is created if it does not exist, and from which each line is taken as
+ * the label of a marker.
+ *
+ * @return either SUCCESS or FAIL.
+ */
+int
+markers_open(void);
+
+
+/**
+ * Check the marker channel for new labels and hand a marker for each of them
+ * to the output sinks, in order with the samples. The channel is actually read
+ * at most once every 10 ms, so this can be called after every sample.
+ */
+void
+markers_poll(void);
+
+
+/**
+ * Close the marker channel. The FIFO is removed if it was created by us.
+ */
+void
+markers_close(void);
+
+
+#endif // MARKERS_H
@@ -0,0 +1,181 @@
+// This file is part of "austin" which is released under GPL.
+//
+// See file LICENCE or go to http://www.gnu.org/licenses/ for full license
+// details.
+//
+// Austin is a Python frame stack sampler for CPython.
+//
+// Copyright (c) 2018 Gabriele N. Tornetta <phoenix1987@gmail.com>.
+// All rights reserved.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+// Remote addresses are used as file offsets.
+#define _FILE_OFFSET_BITS 64
+
+#include "platform.h"
+
+#if defined PL_LINUX
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "core.h"
+#include "hints.h"
+#include "mem.h"
+
+
+// The memory of a process is read either from its /proc/<pid>/mem file or,
+// for processes that only survive as a core file, from the core file.
+typedef struct {
+  pid_t    pid;
+  int      fd;
+  core_t * core;
+} proc_mem_t;
+
+
+int                 _proc_mem_count = 0;
+
+static proc_mem_t * _proc_mem       = NULL;
+static int          _proc_mem_size  = 0;
+static int          _proc_mem_last  = 0;  // Index of the last hit.
+
+
+// ----------------------------------------------------------------------------
+static int
+_proc_mem__grow(void) {
+  if (_proc_mem_count < _proc_mem_size)
+    SUCCESS;
+
+  int          size = _proc_mem_size ? _proc_mem_size << 1 : 16;
+  proc_mem_t * pm   = (proc_mem_t *) realloc(_proc_mem, size * sizeof(proc_mem_t));
+  if (!isvalid(pm))
+    FAIL;
+  _proc_mem      = pm;
+  _proc_mem_size = size;
+
+  SUCCESS;
+} /* _proc_mem__grow */
+
+
+// ----------------------------------------------------------------------------
+int
+proc_mem__lookup(pid_t pid) {
+  if (_proc_mem[_proc_mem_last].pid == pid)
+    return _proc_mem_last;
+
+  for (register int i = 0; i < _proc_mem_count; i++) {
+    if (_proc_mem[i].pid == pid) {
+      _proc_mem_last = i;
+      return i;
+    }
+  }
+
+  return -1;
+} /* proc_mem__lookup */
+
+
+// ----------------------------------------------------------------------------
+ssize_t
+proc_mem__read(int index, void * addr, ssize_t len, void * buf) {
+  proc_mem_t * pm = _proc_mem + index;
+
+  if (isvalid(pm->core)) {
+    ssize_t result = core__read(pm->core, addr, len, buf);
+    if (result == -1)
+      errno = EFAULT;
+    return result;
+  }
+
+  return pread(pm->fd, buf, len, (off_t) addr);
+} /* proc_mem__read */
+
+
+// ----------------------------------------------------------------------------
+int
+proc_mem__open(pid_t pid) {
+  char path[32];
+
+  if (_proc_mem_count && proc_mem__lookup(pid) >= 0)
+    SUCCESS;
+
+  if (fail(_proc_mem__grow()))
+    FAIL;
+
+  sprintf(path, "/proc/%d/mem", pid);
+  int fd = open(path, O_RDONLY);
+  if (fd < 0)
+    FAIL;
+
+  _proc_mem[_proc_mem_count].pid  = pid;
+  _proc_mem[_proc_mem_count].fd   = fd;
+  _proc_mem[_proc_mem_count].core = NULL;
+  _proc_mem_count++;
+
+  SUCCESS;
+} /* proc_mem__open */
+
+
+// ----------------------------------------------------------------------------
+pid_t
+proc_mem__open_core(const char * path) {
+  if (fail(_proc_mem__grow()))
+    return 0;
+
+  core_t * core = core_new(path);
+  if (!isvalid(core))
+    return 0;
+
+  _proc_mem[_proc_mem_count].pid  = core->pid;
+  _proc_mem[_proc_mem_count].fd   = -1;
+  _proc_mem[_proc_mem_count].core = core;
+  _proc_mem_count++;
+
+  return core->pid;
+} /* proc_mem__open_core */
+
+
+// ----------------------------------------------------------------------------
+core_t *
+proc_mem__get_core(pid_t pid) {
+  int index = _proc_mem_count ? proc_mem__lookup(pid) : -1;
+
+  return index >= 0 ? _proc_mem[index].core : NULL;
+} /* proc_mem__get_core */
+
+
+// ----------------------------------------------------------------------------
+void
+proc_mem__close(pid_t pid) {
+  for (register int i = 0; i < _proc_mem_count; i++) {
+    if (_proc_mem[i].pid == pid) {
+      if (isvalid(_proc_mem[i].core))
+        core__destroy(_proc_mem[i].core);
+      else
+        close(_proc_mem[i].fd);
+      _proc_mem[i] = _proc_mem[--_proc_mem_count];
+      _proc_mem_last = 0;
+      break;
+    }
+  }
+
+  if (_proc_mem_count == 0) {
+    sfree(_proc_mem);
+    _proc_mem_size = 0;
+  }
+} /* proc_mem__close */
+
+#endif
@@ -24,6 +24,7 @@
 #define MEM_H
 
 
+#include <string.h>
 #include <sys/types.h>
 
 #include "platform.h"
@@ -49,6 +50,7 @@
 #include "logging.h"
 
 #define OUT_OF_BOUND                  -1
+#define MEM_BATCH_MAX                 64  // Maximum number of chunks per read
 
 
 /**
@@ -86,6 +88,75 @@ typedef struct {
 } raddr_t;
 
 
+#if defined PL_LINUX
+#include "core.h"
+
+// Number of processes whose memory is read from /proc/<pid>/mem or from a core
+// file.
+extern int _proc_mem_count;
+
+
+/**
+ * Read the memory of the given process from /proc/<pid>/mem from now on,
+ * instead of using process_vm_readv. The file is opened once and kept open
+ * until proc_mem__close is called.
+ * @param pid_t the process ID
+ * @return      zero on success, otherwise non-zero.
+ */
+int
+proc_mem__open(pid_t);
+
+
+/**
+ * Serve the memory of a dumped process from the given core file. The core file
+ * is mapped once and kept mapped until proc_mem__close is called.
+ * @param char * the path of the core file
+ * @return       the process ID of the dumped process, or 0 on failure.
+ */
+pid_t
+proc_mem__open_core(const char *);
+
+
+/**
+ * Close the memory source of the given process, if any.
+ * @param pid_t the process ID
+ */
+void
+proc_mem__close(pid_t);
+
+
+/**
+ * Get the core file of the given process.
+ * @param pid_t the process ID
+ * @return      the core object, or NULL if the process is not a dumped one.
+ */
+core_t *
+proc_mem__get_core(pid_t);
+
+
+/**
+ * Look up the memory source of the given process.
+ * @param pid_t the process ID
+ * @return      an index to pass to proc_mem__read, or -1 if the process has no
+ *              memory source.
+ */
+int
+proc_mem__lookup(pid_t);
+
+
+/**
+ * Read from the memory source with the given index.
+ * @param int     the index returned by proc_mem__lookup
+ * @param void *  the remote address
+ * @param ssize_t the number of bytes to read
+ * @param void *  the destination buffer
+ * @return        the number of bytes read, or -1 on error.
+ */
+ssize_t
+proc_mem__read(int, void *, ssize_t, void *);
+#endif
+
+
 /**
  * Copy a chunk of memory from a portion of the virtual memory of another
  * process.
@@ -101,15 +172,22 @@ copy_memory(pid_t pid, void * addr, ssize_t len, void * buf) {
   ssize_t result;
 
   #if defined(PL_LINUX)                                              /* LINUX */
-  struct iovec local[1];
-  struct iovec remote[1];
+  int index = _proc_mem_count ? proc_mem__lookup(pid) : -1;
 
-  local[0].iov_base = buf;
-  local[0].iov_len = len;
-  remote[0].iov_base = addr;
-  remote[0].iov_len = len;
+  if (index >= 0) {
+    result = proc_mem__read(index, addr, len, buf);
+  }
+  else {
+    struct iovec local[1];
+    struct iovec remote[1];
 
-  result = process_vm_readv(pid, local, 1, remote, 1, 0);
+    local[0].iov_base = buf;
+    local[0].iov_len = len;
+    remote[0].iov_base = addr;
+    remote[0].iov_len = len;
+
+    result = process_vm_readv(pid, local, 1, remote, 1, 0);
+  }
   if (result == -1) {
     switch (errno) {
     case ESRCH:
@@ -161,4 +239,66 @@ copy_memory(pid_t pid, void * addr, ssize_t len, void * buf) {
   return result != len;
 }
 
+
+/**
+ * Copy chunks of the same size from several locations of the virtual memory of
+ * another process, with as few system calls as the platform allows. The chunks
+ * are stored one after the other in the destination buffer. Those that cannot
+ * be copied are zeroed.
+ * @param pid_t   the process reference (platform-dependent)
+ * @param void ** the remote addresses of the chunks
+ * @param int     the number of chunks, at most MEM_BATCH_MAX
+ * @param ssize_t the size of each chunk
+ * @param void *  the destination buffer, expected to be at least as large as
+ *                the number of chunks times their size.
+ * @return        the number of chunks copied.
+ */
+static inline int
+copy_memory_batch(pid_t pid, void ** addrs, int n, ssize_t len, void * buf) {
+  int copied = 0;
+
+  #if defined(PL_LINUX)                                              /* LINUX */
+  if (!_proc_mem_count || proc_mem__lookup(pid) < 0) {
+    struct iovec local[1];
+    struct iovec remote[MEM_BATCH_MAX];
+
+    for (register int i = 0; i < n; i++) {
+      remote[i].iov_base = addrs[i];
+      remote[i].iov_len  = len;
+    }
+
+    // The transfer stops at the first chunk that cannot be copied, so we skip
+    // it and carry on from the next one.
+    for (register int i = 0; i < n;) {
+      local[0].iov_base = buf + i * len;
+      local[0].iov_len  = (n - i) * len;
+
+      ssize_t result = process_vm_readv(pid, local, 1, remote + i, n - i, 0);
+      if (result == -1 && errno != EFAULT) {
+        memset(buf + i * len, 0, (n - i) * len);
+        break;
+      }
+
+      int done = result > 0 ? result / len : 0;
+      copied += done;
+      i      += done;
+
+      if (i < n)
+        memset(buf + (i++) * len, 0, len);
+    }
+
+    return copied;
+  }
+  #endif                                                               /* ANY */
+
+  for (register int i = 0; i < n; i++) {
+    if (copy_memory(pid, addrs[i], len, buf + i * len) == 0)
+      copied++;
+    else
+      memset(buf + i * len, 0, len);
+  }
+
+  return copied;
+}
+
 #endif // MEM_H
@@ -82,6 +82,25 @@ const char * MNOPROC = \
 "please open an issue at\n"
 URL("https://github.com/P403n1x87/austin/issues");
 
+#if defined PL_LINUX
+const char * MCGROUP = \
+"🗂️ Cannot read the processes in the given cgroup. Make sure that the path is\n"
+"correct and that Austin has the permissions to read it";
+#endif
+
+const char * MSINK = \
+"📤 Cannot open the output sinks. Make sure that the paths can be written to,\n"
+"that every FIFO has a reader and that an aggregator is listening on every Unix\n"
+"socket";
+
+const char * MAGGREGATOR = \
+"🧺 Cannot start the aggregator. Make sure that the directory exists, that it\n"
+"can be written to and that no other aggregator is using it";
+
+const char * MMARKERS = \
+"🔖 Cannot open the marker channel. Make sure that the path is either a FIFO or\n"
+"that it can be created";
+
 const char * MNOPYTHON = \
 "👾 It looks like you are trying to profile a process that is not a Python\n"
 "process. Make sure that you are targeting the right application. If the Python\n"
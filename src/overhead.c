@@ -0,0 +1,444 @@
+// This file is part of "austin" which is released under GPL.
+//
+// See file LICENCE or go to http://www.gnu.org/licenses/ for full license
+// details.
+//
+// Austin is a Python frame stack sampler for CPython.
+//
+// Copyright (c) 2018 Gabriele N. Tornetta <phoenix1987@gmail.com>.
+// All rights reserved.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "platform.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined PL_LINUX
+#include <dirent.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/prctl.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+#include "argparse.h"
+#include "hints.h"
+#include "logging.h"
+#include "stats.h"
+
+#include "overhead.h"
+
+
+#define OVERHEAD_MAX_TASKS              1024
+#define OVERHEAD_BUFFER_SIZE            4096
+
+// The counters of the sampled process.
+#define OVERHEAD_CPU_TIME                  0  // ns
+#define OVERHEAD_RUN_DELAY                 1  // ns
+#define OVERHEAD_VCSW                      2
+#define OVERHEAD_IVCSW                     3
+#define OVERHEAD_MINFLT                    4
+#define OVERHEAD_MAJFLT                    5
+#define OVERHEAD_PROBE_RUNS                6
+#define OVERHEAD_PROBE_TIME                7  // μs
+#define OVERHEAD_COUNTERS                  8
+
+// The counters that are kept for each thread, as they are lost when the
+// thread exits.
+#define OVERHEAD_TASK_COUNTERS             4
+
+
+typedef struct {
+  pid_t   tid;
+  ustat_t values[OVERHEAD_TASK_COUNTERS];
+} overhead_task_t;
+
+
+typedef struct {
+  ustat_t windows;
+  ctime_t time;
+  double  values[OVERHEAD_COUNTERS];
+} overhead_totals_t;
+
+
+static pid_t             _pid          = 0;
+static int               _sampling     = -1;  // No window is open.
+static ctime_t           _window_start = 0;
+
+static overhead_task_t   _tasks[2][OVERHEAD_MAX_TASKS];
+static int               _n_tasks[2]   = {0, 0};
+static int               _current      = 0;
+static ustat_t           _faults[2];
+
+// The totals of the quiet and of the sampling windows.
+static overhead_totals_t _totals[2];
+
+static pid_t             _probe_pid    = 0;
+static int               _probe_fd     = -1;
+
+
+#if defined PL_LINUX
+// ---- PRIVATE ---------------------------------------------------------------
+
+// ----------------------------------------------------------------------------
+static ssize_t
+_read_file(const char * path, char * buffer) {
+  int fd = open(path, O_RDONLY);
+  if (fd < 0)
+    return -1;
+
+  ssize_t len = read(fd, buffer, OVERHEAD_BUFFER_SIZE - 1);
+  close(fd);
+
+  if (len >= 0)
+    buffer[len] = '\0';
+
+  return len;
+} /* _read_file */
+
+
+// ----------------------------------------------------------------------------
+static int
+_overhead__read_task(pid_t tid, ustat_t * values) {
+  char buffer[OVERHEAD_BUFFER_SIZE];
+  char path[64];
+
+  // Time on the CPU and time spent waiting for it, both in ns.
+  sprintf(path, "/proc/%d/task/%d/schedstat", _pid, tid);
+  if (
+    _read_file(path, buffer) <= 0 ||
+    sscanf(buffer, "%lu %lu", &values[OVERHEAD_CPU_TIME], &values[OVERHEAD_RUN_DELAY]) != 2
+  )
+    FAIL;
+
+  sprintf(path, "/proc/%d/task/%d/status", _pid, tid);
+  if (_read_file(path, buffer) <= 0)
+    FAIL;
+
+  // The voluntary entry comes first, so this is not matched by the involuntary
+  // one.
+  char * p = strstr(buffer, "voluntary_ctxt_switches:");
+  if (!isvalid(p))
+    FAIL;
+  values[OVERHEAD_VCSW] = strtoul(p + sizeof("voluntary_ctxt_switches:") - 1, &p, 10);
+
+  if (!isvalid(p = strstr(p, "nonvoluntary_ctxt_switches:")))
+    FAIL;
+  values[OVERHEAD_IVCSW] = strtoul(p + sizeof("nonvoluntary_ctxt_switches:") - 1, NULL, 10);
+
+  SUCCESS;
+} /* _overhead__read_task */
+
+
+// ----------------------------------------------------------------------------
+// The page faults of all the threads of the process, including those that have
+// exited, are in the stat file of the process.
+static int
+_overhead__read_faults(ustat_t * faults) {
+  char buffer[OVERHEAD_BUFFER_SIZE];
+  char path[32];
+
+  sprintf(path, "/proc/%d/stat", _pid);
+  if (_read_file(path, buffer) <= 0)
+    FAIL;
+
+  // The command name might contain spaces so we start from the last ')'. This
+  // is followed by field 3, and we want fields 10 and 12.
+  char * p = strrchr(buffer, ')');
+  if (!isvalid(p) || sscanf(p + 2, "%*c %*d %*d %*d %*d %*d %*u %lu %*u %lu", &faults[0], &faults[1]) != 2)
+    FAIL;
+
+  SUCCESS;
+} /* _overhead__read_faults */
+
+
+// ----------------------------------------------------------------------------
+// Take a new snapshot of the counters of the process and add what has changed
+// since the previous one to the given values. Threads that were not there in
+// the previous snapshot count in full, since they have been created in the
+// meantime.
+static void
+_overhead__snapshot(double * values) {
+  int               next  = 1 - _current;
+  overhead_task_t * tasks = _tasks[next];
+  int               n     = 0;
+  ustat_t           faults[2];
+  char              path[32];
+
+  sprintf(path, "/proc/%d/task", _pid);
+  DIR * dir = opendir(path);
+  if (isvalid(dir)) {
+    struct dirent * ent;
+    while (isvalid(ent = readdir(dir)) && n < OVERHEAD_MAX_TASKS) {
+      pid_t tid = atoi(ent->d_name);
+      if (tid <= 0 || fail(_overhead__read_task(tid, tasks[n].values)))
+        continue;
+      tasks[n].tid = tid;
+
+      if (isvalid(values)) {
+        overhead_task_t * prev = NULL;
+        for (register int i = 0; i < _n_tasks[_current]; i++) {
+          if (_tasks[_current][i].tid == tid) {
+            prev = &(_tasks[_current][i]);
+            break;
+          }
+        }
+        for (register int i = 0; i < OVERHEAD_TASK_COUNTERS; i++)
+          values[i] += tasks[n].values[i] - (isvalid(prev) ? prev->values[i] : 0);
+      }
+
+      n++;
+    }
+    closedir(dir);
+  }
+
+  _n_tasks[next] = n;
+  _current       = next;
+
+  if (success(_overhead__read_faults(faults))) {
+    if (isvalid(values)) {
+      values[OVERHEAD_MINFLT] += faults[0] - _faults[0];
+      values[OVERHEAD_MAJFLT] += faults[1] - _faults[1];
+    }
+    _faults[0] = faults[0];
+    _faults[1] = faults[1];
+  }
+} /* _overhead__snapshot */
+
+
+// ----------------------------------------------------------------------------
+// Run the probe command over and over again, and report the duration of each
+// run through the given pipe. This runs in a process of its own, so that the
+// runs of the probe are not held up by sampling.
+static void
+_overhead__probe(int fd) {
+  // Go away with the parent, and with the signals that are meant for it.
+  prctl(PR_SET_PDEATHSIG, SIGTERM);
+  signal(SIGINT,  SIG_DFL);
+  signal(SIGTERM, SIG_DFL);
+
+  for (;;) {
+    ctime_t start = gettime();
+
+    pid_t pid = fork();
+    if (pid == 0) {
+      int null = open("/dev/null", O_RDWR);
+      dup2(null, STDIN_FILENO);
+      dup2(null, STDOUT_FILENO);
+      dup2(null, STDERR_FILENO);
+      execl("/bin/sh", "sh", "-c", pargs.probe, NULL);
+      _exit(127);
+    }
+    if (pid < 0)
+      _exit(1);
+
+    int status;
+    waitpid(pid, &status, 0);
+
+    ctime_t duration = gettime() - start;
+    if (write(fd, &duration, sizeof(duration)) != sizeof(duration))
+      _exit(0);
+  }
+} /* _overhead__probe */
+
+
+// ----------------------------------------------------------------------------
+static void
+_overhead__read_probe(double * values) {
+  ctime_t durations[64];
+  ssize_t len;
+
+  if (_probe_fd < 0)
+    return;
+
+  while ((len = read(_probe_fd, durations, sizeof(durations))) > 0) {
+    for (register size_t i = 0; i < len / sizeof(ctime_t); i++) {
+      values[OVERHEAD_PROBE_RUNS]++;
+      values[OVERHEAD_PROBE_TIME] += durations[i];
+    }
+  }
+} /* _overhead__read_probe */
+#endif
+
+
+// ---- PUBLIC ----------------------------------------------------------------
+
+// ----------------------------------------------------------------------------
+int
+overhead_open(pid_t pid) {
+  #if defined PL_LINUX
+  _pid      = pid;
+  _sampling = -1;
+  memset(_totals, 0, sizeof(_totals));
+
+  if (isvalid(pargs.probe)) {
+    int fds[2];
+    if (pipe(fds) != 0)
+      FAIL;
+
+    if ((_probe_pid = fork()) == 0) {
+      close(fds[0]);
+      _overhead__probe(fds[1]);
+    }
+    close(fds[1]);
+
+    if (_probe_pid < 0) {
+      close(fds[0]);
+      _probe_pid = 0;
+      FAIL;
+    }
+
+    // The durations of the runs are collected at the end of each window.
+    _probe_fd = fds[0];
+    fcntl(_probe_fd, F_SETFL, fcntl(_probe_fd, F_GETFL) | O_NONBLOCK);
+
+    log_i("Overhead probe: %s (PID %d)", pargs.probe, _probe_pid);
+  }
+
+  SUCCESS;
+
+  #else
+  log_w("The overhead of sampling cannot be measured on this platform");
+  FAIL;
+  #endif
+} /* overhead_open */
+
+
+// ----------------------------------------------------------------------------
+void
+overhead_switch(int sampling) {
+  #if defined PL_LINUX
+  if (_pid == 0)
+    return;
+
+  ctime_t now = gettime();
+
+  if (_sampling >= 0) {
+    overhead_totals_t * totals = &(_totals[_sampling]);
+
+    _overhead__snapshot(totals->values);
+    _overhead__read_probe(totals->values);
+    totals->time += now - _window_start;
+    totals->windows++;
+  }
+  else {
+    // Runs of the probe that end before the first window do not count.
+    double discard[OVERHEAD_COUNTERS] = {0};
+    _overhead__snapshot(NULL);
+    _overhead__read_probe(discard);
+  }
+
+  _sampling     = sampling ? 1 : 0;
+  _window_start = now;
+  #endif
+} /* overhead_switch */
+
+
+// ----------------------------------------------------------------------------
+#define _rate(w, c)   (_totals[w].time ? _totals[w].values[c] * 1e6 / _totals[w].time : 0.0)
+
+
+// ----------------------------------------------------------------------------
+// Format the relative change of a counter from the quiet to the sampling
+// windows. There is none to speak of when the counter moves only when sampling.
+static const char *
+_overhead__change(int counter) {
+  static char buffer[32];
+
+  double quiet    = _rate(0, counter);
+  double sampling = _rate(1, counter);
+
+  if (quiet > 0)
+    snprintf(buffer, sizeof(buffer), "%+.2f %%", (sampling / quiet - 1) * 100);
+  else
+    strcpy(buffer, sampling > 0 ? "n/a" : "+0.00 %");
+
+  return buffer;
+} /* _overhead__change */
+
+
+// ----------------------------------------------------------------------------
+void
+overhead_log_report(void) {
+  if (_pid == 0)
+    return;
+
+  if (!_totals[0].windows || !_totals[1].windows) {
+    log_m("⚖️  Not enough windows to measure the overhead on the sampled process.");
+    return;
+  }
+
+  log_m("⚖️  Overhead on the sampled process (sampling/quiet, per second) over %lu/%lu windows",
+    _totals[1].windows, _totals[0].windows
+  );
+
+  log_m("   CPU time           : %.2f/%.2f ms (%s)",
+    _rate(1, OVERHEAD_CPU_TIME) / 1e6, _rate(0, OVERHEAD_CPU_TIME) / 1e6,
+    _overhead__change(OVERHEAD_CPU_TIME)
+  );
+  log_m("   Run queue delay    : %.2f/%.2f ms (%s)",
+    _rate(1, OVERHEAD_RUN_DELAY) / 1e6, _rate(0, OVERHEAD_RUN_DELAY) / 1e6,
+    _overhead__change(OVERHEAD_RUN_DELAY)
+  );
+  log_m("   Voluntary CS       : %.1f/%.1f (%s)",
+    _rate(1, OVERHEAD_VCSW), _rate(0, OVERHEAD_VCSW), _overhead__change(OVERHEAD_VCSW)
+  );
+  log_m("   Involuntary CS     : %.1f/%.1f (%s)",
+    _rate(1, OVERHEAD_IVCSW), _rate(0, OVERHEAD_IVCSW), _overhead__change(OVERHEAD_IVCSW)
+  );
+  log_m("   Minor page faults  : %.1f/%.1f (%s)",
+    _rate(1, OVERHEAD_MINFLT), _rate(0, OVERHEAD_MINFLT), _overhead__change(OVERHEAD_MINFLT)
+  );
+  log_m("   Major page faults  : %.1f/%.1f (%s)",
+    _rate(1, OVERHEAD_MAJFLT), _rate(0, OVERHEAD_MAJFLT), _overhead__change(OVERHEAD_MAJFLT)
+  );
+
+  if (isvalid(pargs.probe)) {
+    double runs[2];
+    for (register int w = 0; w < 2; w++)
+      runs[w] = _totals[w].values[OVERHEAD_PROBE_RUNS];
+
+    log_m("   Probe throughput   : %.2f/%.2f runs (%s)",
+      _rate(1, OVERHEAD_PROBE_RUNS), _rate(0, OVERHEAD_PROBE_RUNS),
+      _overhead__change(OVERHEAD_PROBE_RUNS)
+    );
+    log_m("   Probe duration     : %.2f/%.2f ms on average",
+      runs[1] ? _totals[1].values[OVERHEAD_PROBE_TIME] / runs[1] / 1e3 : 0.0,
+      runs[0] ? _totals[0].values[OVERHEAD_PROBE_TIME] / runs[0] / 1e3 : 0.0
+    );
+  }
+} /* overhead_log_report */
+
+
+// ----------------------------------------------------------------------------
+void
+overhead_close(void) {
+  #if defined PL_LINUX
+  if (_probe_pid > 0) {
+    kill(_probe_pid, SIGTERM);
+    waitpid(_probe_pid, NULL, 0);
+    _probe_pid = 0;
+  }
+
+  if (_probe_fd >= 0) {
+    close(_probe_fd);
+    _probe_fd = -1;
+  }
+  #endif
+
+  _pid = 0;
+} /* overhead_close */
@@ -0,0 +1,76 @@
+// This file is part of "austin" which is released under GPL.
+//
+// See file LICENCE or go to http://www.gnu.org/licenses/ for full license
+// details.
+//
+// Austin is a Python frame stack sampler for CPython.
+//
+// Copyright (c) 2018 Gabriele N. Tornetta <phoenix1987@gmail.com>.
+// All rights reserved.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef OVERHEAD_H
+#define OVERHEAD_H
+
+
+#include <sys/types.h>
+
+
+// Default sampling and quiet windows, in microseconds, when no burst has been
+// requested.
+#define OVERHEAD_DEFAULT_WINDOW    1000000
+
+
+/**
+ * Start measuring the impact of sampling on the given process. If a probe
+ * command has been given, it is run over and over again, in the background,
+ * until the measurement is over.
+ *
+ * @param  pid_t  the PID of the sampled process.
+ *
+ * @return either SUCCESS or FAIL.
+ */
+int
+overhead_open(pid_t);
+
+
+/**
+ * Close the current window, if any, and open a new one. The counters of the
+ * sampled process, and the runs of the probe, since the start of the previous
+ * window are accounted to it.
+ *
+ * @param  int  TRUE if the new window is a sampling one, FALSE if it is a
+ *              quiet one.
+ */
+void
+overhead_switch(int);
+
+
+/**
+ * Log the average impact of the sampling windows against the quiet ones.
+ * Windows that have not been closed, e.g. because sampling has been
+ * interrupted, are not accounted for.
+ */
+void
+overhead_log_report(void);
+
+
+/**
+ * Stop the measurement and the probe command.
+ */
+void
+overhead_close(void);
+
+
+#endif // OVERHEAD_H
@@ -110,6 +110,9 @@ static const char * _dynsym_array[DYNSYM_COUNT] = {
 
 static long _dynsym_hash_array[DYNSYM_COUNT] = {0};
 
+// Number of lineages handed out so far. Each new process object starts its own.
+static unsigned int _lineage_count = 0;
+
 
 #ifdef DEREF_SYM
 static int
@@ -135,12 +138,33 @@ _py_proc__check_sym(py_proc_t * self, char * name, void * value) {
 #define _pclose pclose
 #endif
 
+// Running a binary takes milliseconds, and the processes that we sample
+// together tend to share the same binaries, so we remember the outcome for the
+// most recent ones.
+#define VERSION_CACHE_SIZE              8
+
+static struct {
+  char * binary;
+  int    major, minor, patch;
+} _version_cache[VERSION_CACHE_SIZE];
+
+static int _version_cache_next = 0;
+
 static int
 _get_version_from_executable(char * binary, int * major, int * minor, int * patch) {
   FILE * fp;
   char   version[64];
   char   cmd[256];
 
+  for (register int i = 0; i < VERSION_CACHE_SIZE; i++) {
+    if (isvalid(_version_cache[i].binary) && strcmp(_version_cache[i].binary, binary) == 0) {
+      *major = _version_cache[i].major;
+      *minor = _version_cache[i].minor;
+      *patch = _version_cache[i].patch;
+      return (*major << 16) | (*minor << 8);
+    }
+  }
+
   sprintf(cmd, "%s -V 2>&1", binary);
 
   fp = _popen(cmd, "r");
@@ -155,6 +179,13 @@ _get_version_from_executable(char * binary, int * major, int * minor, int * patc
 
   _pclose(fp);
 
+  sfree(_version_cache[_version_cache_next].binary);
+  _version_cache[_version_cache_next].binary = strdup(binary);
+  _version_cache[_version_cache_next].major  = *major;
+  _version_cache[_version_cache_next].minor  = *minor;
+  _version_cache[_version_cache_next].patch  = *patch;
+  _version_cache_next = (_version_cache_next + 1) % VERSION_CACHE_SIZE;
+
   return (*major << 16) | (*minor << 8);
 }
 
@@ -246,6 +277,8 @@ _py_proc__check_interp_state(py_proc_t * self, void * raddr) {
   PyInterpreterState is;
   PyThreadState      tstate_head;
 
+  py_thread_set_lineage(self->lineage);
+
   if (py_proc__get_type(self, raddr, is))
     return OUT_OF_BOUND;
 
@@ -340,6 +373,39 @@ _py_proc__scan_heap(py_proc_t * self) {
 #endif
 
 
+// ----------------------------------------------------------------------------
+// Check the given candidate interpreter states in bulk. The interpreter states
+// and their thread state heads are read with a single batch each, and only the
+// candidates that refer back to themselves get the full check. Returns the
+// index of the first valid candidate, or -1 if there is none.
+static int
+_py_proc__check_interp_state_batch(py_proc_t * self, void ** raddrs, int n) {
+  PyInterpreterState is[MEM_BATCH_MAX];
+  PyThreadState      tstate_head[MEM_BATCH_MAX];
+  void             * tstate_head_raddrs[MEM_BATCH_MAX];
+
+  if (!copy_memory_batch(PROC_REF, raddrs, n, sizeof(PyInterpreterState), is))
+    return -1;
+
+  for (register int i = 0; i < n; i++)
+    tstate_head_raddrs[i] = is[i].tstate_head;
+
+  if (!copy_memory_batch(PROC_REF, tstate_head_raddrs, n, sizeof(PyThreadState), tstate_head))
+    return -1;
+
+  for (register int i = 0; i < n; i++) {
+    if (
+      tstate_head_raddrs[i] != NULL &&
+      V_FIELD(void*, tstate_head[i], py_thread, o_interp) == raddrs[i] &&
+      _py_proc__check_interp_state(self, raddrs[i]) == 0
+    )
+      return i;
+  }
+
+  return -1;
+}
+
+
 // ----------------------------------------------------------------------------
 static int
 _py_proc__scan_bss(py_proc_t * self) {
@@ -358,26 +424,53 @@ _py_proc__scan_bss(py_proc_t * self) {
   // not strictly required.
   int is_lib = self->lib_path != NULL;
   #endif
+
+  // Collect the candidates in batches, so that they can be checked with as few
+  // remote reads as possible. We go one past the end to flush the last batch.
+  void * candidate_raddrs[MEM_BATCH_MAX];
+  int    n = 0;
+  #ifdef DEBUG
+  void * candidates[MEM_BATCH_MAX];
+  #endif
+
   for (
     register void ** raddr = (void **) self->bss;
-    (void *) raddr < upper_bound;
+    (void *) raddr <= upper_bound;
     raddr++
   ) {
-    if (
+    if ((void *) raddr < upper_bound) {
       #ifdef CHECK_HEAP
-        (is_lib ? _py_proc__is_raddr_within_max_range(self, *raddr)
-                : _py_proc__is_heap_raddr(self, *raddr)) &&
+      if (!(is_lib ? _py_proc__is_raddr_within_max_range(self, *raddr)
+                   : _py_proc__is_heap_raddr(self, *raddr)))
+        continue;
       #endif
-      _py_proc__check_interp_state(self, *raddr) == 0
-    ) {
+
+      #ifdef DEBUG
+      candidates[n]         = raddr;
+      #endif
+      candidate_raddrs[n++] = *raddr;
+
+      if (n < MEM_BATCH_MAX)
+        continue;
+    }
+
+    if (n == 0)
+      continue;
+
+    int i = _py_proc__check_interp_state_batch(self, candidate_raddrs, n);
+    if (i >= 0) {
+      #ifdef DEBUG
       log_d(
         "Possible interpreter state referenced by BSS @ %p (offset %x)",
-        (void *) raddr - (void *) self->bss + (void *) self->map.bss.base,
-        (void *) raddr - (void *) self->bss
+        candidates[i] - (void *) self->bss + (void *) self->map.bss.base,
+        candidates[i] - (void *) self->bss
       );
-      self->is_raddr = *raddr;
+      #endif
+      self->is_raddr = candidate_raddrs[i];
       SUCCESS;
     }
+
+    n = 0;
   }
 
   FAIL;
@@ -465,6 +558,32 @@ _py_proc__find_interpreter_state(py_proc_t * self) {
 #endif  // DEREF_SYM
 
 
+// ----------------------------------------------------------------------------
+// Make a single attempt at locating the interpreter state. Returns 0 if it has
+// been found, OUT_OF_BOUND if there is no point in trying again, and 1 if
+// another attempt is needed.
+static int
+_py_proc__locate_interp_state(py_proc_t * self) {
+  #ifdef DEREF_SYM
+  if (success(_py_proc__find_interpreter_state(self)))
+    SUCCESS;
+  #endif
+
+  if (self->bss == NULL) {
+    self->bss = malloc(self->map.bss.size);
+    if (self->bss == NULL)
+      return OUT_OF_BOUND;
+  }
+
+  if (fail(_py_proc__scan_bss(self)))
+    FAIL;
+
+  log_d("Interpreter state located from BSS scan.");
+
+  SUCCESS;
+}
+
+
 // ----------------------------------------------------------------------------
 static int
 _py_proc__wait_for_interp_state(py_proc_t * self) {
@@ -485,27 +604,8 @@ _py_proc__wait_for_interp_state(py_proc_t * self) {
     attempts++;
     #endif
 
-    #ifdef DEREF_SYM
-    if (fail(_py_proc__find_interpreter_state(self))) {
-    #endif
-      if (self->bss == NULL) {
-        self->bss = malloc(self->map.bss.size);
-      }
-      if (self->bss == NULL)
-        FAIL;
-
-      switch (_py_proc__scan_bss(self)) {
-      case 0:
-        log_d("Interpreter state located from BSS scan.");
-
-      case OUT_OF_BOUND:
-        TIMER_STOP
-      }
-    #ifdef DEREF_SYM
-    } else {
+    if (_py_proc__locate_interp_state(self) != 1)
       TIMER_STOP
-    }
-    #endif
   TIMER_END
 
   if (self->bss != NULL) {
@@ -550,41 +650,29 @@ _py_proc__wait_for_interp_state(py_proc_t * self) {
 
 
 // ----------------------------------------------------------------------------
+// Make a single attempt at analysing the memory maps and the binaries of the
+// process.
 static int
-_py_proc__run(py_proc_t * self, int try_once) {
-  #ifdef DEBUG
-  if (try_once == FALSE)
-    log_d("Start up timeout: %d ms", pargs.timeout / 1000);
-  else
-    log_d("Single attempt to attach to process %d", self->pid);
-  #endif
-
-  TIMER_RESET
-  TIMER_START
-    if (!py_proc__is_running(self)) {
-      set_error(EPROCNPID);
-      FAIL;
-    }
-
-    sfree(self->bin_path);
-    sfree(self->lib_path);
-    self->sym_loaded = 0;
+_py_proc__init_once(py_proc_t * self) {
+  if (!py_proc__is_running(self)) {
+    set_error(EPROCNPID);
+    FAIL;
+  }
 
-    if (success(_py_proc__init(self)))
-      break;
+  sfree(self->bin_path);
+  sfree(self->lib_path);
+  self->sym_loaded = 0;
 
-    if (is_fatal(error))
-      FAIL;
+  return _py_proc__init(self);
+}
 
-    log_d("Process is not ready");
-
-    if (try_once)
-      TIMER_STOP
-  TIMER_END
 
+// ----------------------------------------------------------------------------
+// Check the outcome of the analysis of the process and determine the version
+// of Python.
+static int
+_py_proc__init_version(py_proc_t * self) {
   if (self->bin_path == NULL && self->lib_path == NULL) {
-    if (try_once)
-      log_d("Cannot attach to process %d with a single attempt.", self->pid);
     set_error(EPROC);
     FAIL;
   }
@@ -623,6 +711,40 @@ _py_proc__run(py_proc_t * self, int try_once) {
     set_version(self->version);
   }
 
+  SUCCESS;
+}
+
+
+// ----------------------------------------------------------------------------
+static int
+_py_proc__run(py_proc_t * self, int try_once) {
+  #ifdef DEBUG
+  if (try_once == FALSE)
+    log_d("Start up timeout: %d ms", pargs.timeout / 1000);
+  else
+    log_d("Single attempt to attach to process %d", self->pid);
+  #endif
+
+  TIMER_RESET
+  TIMER_START
+    if (success(_py_proc__init_once(self)))
+      break;
+
+    if (is_fatal(error))
+      FAIL;
+
+    log_d("Process is not ready");
+
+    if (try_once)
+      TIMER_STOP
+  TIMER_END
+
+  if (try_once && self->bin_path == NULL && self->lib_path == NULL)
+    log_d("Cannot attach to process %d with a single attempt.", self->pid);
+
+  if (fail(_py_proc__init_version(self)))
+    FAIL;
+
   if (_py_proc__wait_for_interp_state(self))
     FAIL;
 
@@ -642,6 +764,9 @@ py_proc_new() {
     return NULL;
 
   py_proc->min_raddr = (void *) -1;
+  py_proc->lineage   = ++_lineage_count;
+
+  proc_stats_reset(&(py_proc->stats));
 
   // Pre-hash symbol names
   if (_dynsym_hash_array[0] == 0) {
@@ -654,6 +779,10 @@ py_proc_new() {
   if (!isvalid(py_proc->extra))
     goto error;
 
+  #if defined PL_LINUX
+  py_proc->extra->smaps_fd = -1;
+  #endif
+
   return py_proc;
 
 error:
@@ -693,6 +822,154 @@ py_proc__attach(py_proc_t * self, pid_t pid, int child_process) {
 }
 
 
+// ----------------------------------------------------------------------------
+int
+py_proc__attach_start(py_proc_t * self, pid_t pid) {
+  log_d("Attaching to process with PID %d in steps", pid);
+
+  #if defined PL_WIN                                                   /* WIN */
+  self->extra->h_proc = OpenProcess(
+    PROCESS_VM_READ | PROCESS_QUERY_INFORMATION, FALSE, pid
+  );
+  if (self->extra->h_proc == INVALID_HANDLE_VALUE) {
+    set_error(EPROCATTACH);
+    FAIL;
+  }
+  #endif                                                               /* ANY */
+
+  self->pid             = pid;
+  self->is_raddr        = NULL;
+  self->attach_state    = ATTACH_MAPS;
+  self->attach_deadline = gettime() + pargs.timeout;
+
+  SUCCESS;
+}
+
+
+// ----------------------------------------------------------------------------
+int
+py_proc__attach_step(py_proc_t * self) {
+  switch (self->attach_state) {
+  case ATTACH_MAPS:
+    // The analysis of the binaries is expensive, so we make a single attempt.
+    self->attach_state = success(_py_proc__init_once(self))
+      ? ATTACH_VERSION
+      : ATTACH_FAILED;
+    break;
+
+  case ATTACH_VERSION:
+    self->attach_state = success(_py_proc__init_version(self))
+      ? ATTACH_INTERP
+      : ATTACH_FAILED;
+    break;
+
+  case ATTACH_INTERP:
+    if (!py_proc__is_running(self)) {
+      set_error(EPROCNPID);
+      self->attach_state = ATTACH_FAILED;
+      break;
+    }
+
+    switch (_py_proc__locate_interp_state(self)) {
+    case 0:
+      log_d("Interpreter State de-referenced @ raddr: %p", self->is_raddr);
+      self->timestamp    = gettime();
+      self->attach_state = ATTACH_DONE;
+      break;
+
+    case OUT_OF_BOUND:
+      set_error(EPROCISTIMEOUT);
+      self->attach_state = ATTACH_FAILED;
+    }
+    break;
+  }
+
+  if (self->attach_state < ATTACH_DONE && gettime() > self->attach_deadline) {
+    log_d("Timed out attaching to process %d", self->pid);
+    set_error(EPROCISTIMEOUT);
+    self->attach_state = ATTACH_FAILED;
+  }
+
+  if (self->attach_state >= ATTACH_DONE)
+    sfree(self->bss);
+
+  return self->attach_state;
+}
+
+
+#if defined PL_LINUX
+// ----------------------------------------------------------------------------
+int
+py_proc__attach_child(py_proc_t * self, pid_t pid, py_proc_t * parent) {
+  if (!isvalid(parent) || !isvalid(parent->is_raddr))
+    FAIL;
+
+  log_d("Attaching to process with PID %d, child of %d", pid, parent->pid);
+
+  self->pid = pid;
+
+  // A forked child inherits the address space of its parent, so we expect to
+  // find the interpreter state at the same address.
+  _py_proc__select_mem_backend(self);
+  if (fail(_py_proc__check_interp_state(self, parent->is_raddr))) {
+    log_d("Process %d is not a fork of %d", pid, parent->pid);
+    FAIL;
+  }
+
+  self->bin_path = isvalid(parent->bin_path) ? strdup(parent->bin_path) : NULL;
+  self->lib_path = isvalid(parent->lib_path) ? strdup(parent->lib_path) : NULL;
+
+  self->map                   = parent->map;
+  self->min_raddr             = parent->min_raddr;
+  self->max_raddr             = parent->max_raddr;
+  self->sym_loaded            = parent->sym_loaded;
+  self->version               = parent->version;
+  self->tstate_curr_raddr     = parent->tstate_curr_raddr;
+  self->py_runtime_raddr      = parent->py_runtime_raddr;
+  self->interp_head_raddr     = parent->interp_head_raddr;
+  self->is_raddr              = parent->is_raddr;
+  self->tstate_current_offset = parent->tstate_current_offset;
+  self->lineage               = parent->lineage;
+  self->forked                = TRUE;
+
+  if (fail(_py_proc__init_metrics(self)))
+    FAIL;
+
+  self->timestamp = gettime();
+
+  SUCCESS;
+}
+
+
+// ----------------------------------------------------------------------------
+int
+py_proc__is_fork_valid(py_proc_t * self) {
+  return success(_py_proc__check_interp_state(self, self->is_raddr));
+}
+
+
+// ----------------------------------------------------------------------------
+int
+py_proc__attach_core(py_proc_t * self, const char * core_file) {
+  log_d("Attaching to core file %s", core_file);
+
+  if (!(self->pid = proc_mem__open_core(core_file))) {
+    set_error(EPROCATTACH);
+    FAIL;
+  }
+
+  self->extra->core = proc_mem__get_core(self->pid);
+
+  if (fail(_py_proc__run(self, TRUE))) {
+    log_ie("Cannot find a Python interpreter in the core file.");
+    FAIL;
+  }
+
+  SUCCESS;
+}
+#endif
+
+
 // ----------------------------------------------------------------------------
 int
 py_proc__start(py_proc_t * self, const char * exec, char * argv[]) {
@@ -847,29 +1124,18 @@ py_proc__find_current_thread_offset(py_proc_t * self, void * thread_raddr) {
   if (self->py_runtime_raddr == NULL)
     FAIL;
 
-  void            * interp_head_raddr;
-  _PyRuntimeState   py_runtime;
+  // Copy the _PyRuntimeState structure over and search the offset of the
+  // current thread in it locally.
+  void * py_runtime[PYRUNTIMESTATE_SIZE / sizeof(void *)];
 
-  if (py_proc__get_type(self, self->py_runtime_raddr, py_runtime))
+  if (py_proc__memcpy(self, self->py_runtime_raddr, sizeof(py_runtime), py_runtime))
     FAIL;
 
-  interp_head_raddr = V_FIELD(void *, py_runtime, py_runtime, o_interp_head);
-
-  // Search offset of current thread in _PyRuntimeState structure
-  PyInterpreterState is;
-  py_proc__get_type(self, interp_head_raddr, is);
-  void * current_thread_raddr;
-
   register int hit_count = 0;
-  for (
-    register void ** raddr = (void **) self->py_runtime_raddr;
-    (void *) raddr < self->py_runtime_raddr + PYRUNTIMESTATE_SIZE;
-    raddr++
-  ) {
-    py_proc__get_type(self, raddr, current_thread_raddr);
-    if (current_thread_raddr == thread_raddr) {
+  for (register int i = 0; i < PYRUNTIMESTATE_SIZE / sizeof(void *); i++) {
+    if (py_runtime[i] == thread_raddr) {
       if (++hit_count == 2) {
-        self->tstate_current_offset = (void *) raddr - self->py_runtime_raddr;
+        self->tstate_current_offset = i * sizeof(void *);
         log_d(
           "Offset of _PyRuntime.gilstate.tstate_current found at %x",
           self->tstate_current_offset
@@ -883,6 +1149,35 @@ py_proc__find_current_thread_offset(py_proc_t * self, void * thread_raddr) {
 }
 
 
+// ----------------------------------------------------------------------------
+int
+py_proc__dump(py_proc_t * self) {
+  PyInterpreterState is;
+  if (fail(py_proc__get_type(self, self->is_raddr, is)))
+    FAIL;
+
+  fprintf(pargs.output_file, "Process %d (Python %d.%d)\n",
+    self->pid, self->version >> 16, (self->version >> 8) & 0xFF
+  );
+
+  if (is.tstate_head != NULL) {
+    raddr_t raddr = { .pid = PROC_REF, .addr = is.tstate_head };
+    py_thread_t py_thread;
+    py_thread_set_lineage(self->lineage);
+    if (fail(py_thread__fill_from_raddr(&py_thread, &raddr)))
+      FAIL;
+
+    do {
+      py_thread__print_stack(&py_thread);
+    } while (success(py_thread__next(&py_thread)));
+  }
+
+  fputc('\n', pargs.output_file);
+
+  SUCCESS;
+}
+
+
 // ----------------------------------------------------------------------------
 int
 py_proc__is_running(py_proc_t * self) {
@@ -894,6 +1189,9 @@ py_proc__is_running(py_proc_t * self) {
   return success(check_pid(self->pid));
 
   #else                                                              /* LINUX */
+  if (isvalid(self->extra->core))
+    return TRUE;  // A dumped process never exits.
+
   return !(kill(self->pid, 0) == -1 && errno == ESRCH);
   #endif
 }
@@ -917,12 +1215,140 @@ py_proc__get_memory_delta(py_proc_t * self) {
 }
 
 
+// ----------------------------------------------------------------------------
+// Hold on to the sample of the thread holding the GIL until the next memory
+// reading.
+static void
+_py_proc__defer_sample(py_proc_t * self, py_thread_t * py_thread, ctime_t delta) {
+  const char * stack = py_thread__format_collapsed_stack(py_thread, &delta);
+  if (!isvalid(stack))
+    return;
+
+  if (self->mem_sample_count == self->mem_sample_size) {
+    int           size    = self->mem_sample_size ? self->mem_sample_size << 1 : 64;
+    py_sample_t * samples = (py_sample_t *) realloc(
+      self->mem_samples, size * sizeof(py_sample_t)
+    );
+    if (!isvalid(samples))
+      return;
+    self->mem_samples     = samples;
+    self->mem_sample_size = size;
+  }
+
+  py_sample_t * sample = &(self->mem_samples[self->mem_sample_count]);
+  if (!isvalid(sample->stack = strdup(stack)))
+    return;
+  sample->thread = *py_thread;
+  sample->delta  = delta;
+
+  self->mem_sample_count++;
+} /* _py_proc__defer_sample */
+
+
+// Share of a delta up to the given cumulative fraction, less what has already
+// been attributed.
+#define _share(delta, fraction, attributed) /* as */ \
+  ((ssize_t) ((double) (delta) * (fraction)) - (attributed))
+
+
+// ----------------------------------------------------------------------------
+// Print the deferred samples, sharing the memory delta among them in
+// proportion to their time deltas.
+static void
+_py_proc__flush_samples(py_proc_t * self, ssize_t mem_delta, mem_breakdown_t * mem) {
+  ctime_t         total = 0;
+  ctime_t         cumulative = 0;
+  ssize_t         attributed = 0;
+  mem_breakdown_t mem_attributed = {0, 0, 0};
+
+  for (register int i = 0; i < self->mem_sample_count; i++)
+    total += self->mem_samples[i].delta;
+
+  for (register int i = 0; i < self->mem_sample_count; i++) {
+    py_sample_t * sample = &(self->mem_samples[i]);
+
+    // Work out the shares from the cumulative weights so that they add up to
+    // the memory deltas exactly.
+    cumulative += total ? sample->delta : 1;
+    double  fraction = (double) cumulative / (total ? total : self->mem_sample_count);
+    ssize_t share = _share(mem_delta, fraction, attributed);
+    attributed += share;
+
+    if (isvalid(mem)) {
+      sample->thread.mem.anon  = _share(mem->anon,  fraction, mem_attributed.anon);
+      sample->thread.mem.file  = _share(mem->file,  fraction, mem_attributed.file);
+      sample->thread.mem.shmem = _share(mem->shmem, fraction, mem_attributed.shmem);
+      mem_attributed.anon  += sample->thread.mem.anon;
+      mem_attributed.file  += sample->thread.mem.file;
+      mem_attributed.shmem += sample->thread.mem.shmem;
+    }
+
+    py_thread__print_sample(&(sample->thread), sample->stack, sample->delta, share);
+
+    free(sample->stack);
+  }
+
+  self->mem_sample_count = 0;
+} /* _py_proc__flush_samples */
+
+
+// ----------------------------------------------------------------------------
+// Print the sample of a thread, or aggregate it if a stack table is attached to
+// the process. Aggregated stacks do not carry the process and thread frames.
+static void
+_py_proc__emit_sample(py_proc_t * self, py_thread_t * py_thread, ctime_t delta, ssize_t mem_delta) {
+  if (pargs.heat) {
+    py_thread__add_heat(py_thread, delta);
+    return;
+  }
+
+  if (!isvalid(self->stacks)) {
+    py_thread__print_collapsed_stack(py_thread, delta, mem_delta);
+    return;
+  }
+
+  const char * stack = py_thread__format_collapsed_stack(py_thread, &delta);
+  if (!isvalid(stack))
+    return;
+
+  const char * frames = strchr(stack, ';');
+  if (!isvalid(frames) || !isvalid(frames = strchr(frames + 1, ';')))
+    return;  // No frames to aggregate
+
+  stack_table__add(self->stacks, frames + 1, self->stack_slot, delta);
+} /* _py_proc__emit_sample */
+
+
+// ----------------------------------------------------------------------------
+void
+py_proc__resume(py_proc_t * self) {
+  self->timestamp = gettime();
+
+  if (pargs.memory) {
+    // The memory delta across the gap does not belong to any of the samples.
+    _py_proc__flush_samples(self, 0, NULL);
+    self->last_resident_memory = _py_proc__get_resident_memory(self);
+    self->mem_timestamp        = self->timestamp;
+
+    #if defined PL_LINUX
+    if (pargs.smaps)
+      _py_proc__get_smaps_delta(self, NULL);
+    #endif
+  }
+
+  #if defined PL_LINUX
+  _py_proc__resume_tasks(self);
+  #endif
+} /* py_proc__resume */
+
+
 // ----------------------------------------------------------------------------
 int
 py_proc__sample(py_proc_t * self) {
   ssize_t   mem_delta = 0;
   void    * current_thread = NULL;
   ctime_t   delta = gettime() - self->timestamp;  // Time delta since last sample.
+  int       defer_memory = pargs.memory && pargs.t_memory_interval;
 
   PyInterpreterState is;
   if (fail(py_proc__get_type(self, self->is_raddr, is)))
@@ -931,6 +1357,7 @@ py_proc__sample(py_proc_t * self) {
   if (is.tstate_head != NULL) {
     raddr_t raddr = { .pid = PROC_REF, .addr = is.tstate_head };
     py_thread_t py_thread;
+    py_thread_set_lineage(self->lineage);
     if (fail(py_thread__fill_from_raddr(&py_thread, &raddr)))
       FAIL;
 
@@ -940,6 +1367,10 @@ py_proc__sample(py_proc_t * self) {
     }
 
     do {
+      int holds_gil = FALSE;
+
+      py_thread.mem = (mem_breakdown_t) {0, 0, 0};
+
       if (pargs.memory) {
         mem_delta = 0;
         if (self->py_runtime_raddr != NULL && current_thread == (void *) -1) {
@@ -949,15 +1380,50 @@ py_proc__sample(py_proc_t * self) {
             current_thread = py_proc__get_current_thread_state_raddr(self);
         }
         if (py_thread.raddr.addr == current_thread) {
-          mem_delta = py_proc__get_memory_delta(self);
+          holds_gil = TRUE;
+          if (!defer_memory) {
+            mem_delta = py_proc__get_memory_delta(self);
+            #if defined PL_LINUX
+            if (pargs.smaps)
+              _py_proc__get_smaps_delta(self, &(py_thread.mem));
+            #endif
+          }
           log_t("Thread %lx holds the GIL", py_thread.tid);
         }
       }
 
-      py_thread__print_collapsed_stack(&py_thread, delta, mem_delta);
+      #if defined PL_LINUX
+      if (TASK_METRICS)
+        _py_proc__sample_task(self, &py_thread);
+      #endif
+
+      if (holds_gil && defer_memory)
+        _py_proc__defer_sample(self, &py_thread, delta);
+      else
+        _py_proc__emit_sample(self, &py_thread, delta, mem_delta);
     } while (success(py_thread__next(&py_thread)));
   }
 
+  if (
+    defer_memory && self->mem_sample_count
+  &&self->timestamp + delta - self->mem_timestamp >= pargs.t_memory_interval
+  ) {
+    mem_breakdown_t mem = {0, 0, 0};
+
+    mem_delta = py_proc__get_memory_delta(self);
+    #if defined PL_LINUX
+    if (pargs.smaps)
+      _py_proc__get_smaps_delta(self, &mem);
+    #endif
+    _py_proc__flush_samples(self, mem_delta, &mem);
+    self->mem_timestamp = self->timestamp + delta;
+  }
+
+  #if defined PL_LINUX
+  if (TASK_METRICS)
+    _py_proc__tick_tasks(self);
+  #endif
+
   self->timestamp += delta;
 
   SUCCESS;
@@ -992,8 +1458,20 @@ py_proc__destroy(py_proc_t * self) {
   if (self->bss != NULL)
     free(self->bss);
 
-  if (self->extra != NULL)
+  if (self->mem_samples != NULL) {
+    _py_proc__flush_samples(self, 0, NULL);
+    free(self->mem_samples);
+  }
+
+  if (self->extra != NULL) {
+    #if defined PL_LINUX
+    proc_mem__close(self->pid);
+    _py_proc__destroy_tasks(self);
+    if (self->extra->smaps_fd >= 0)
+      close(self->extra->smaps_fd);
+    #endif
     free(self->extra);
+  }
 
   free(self);
 }
@@ -26,6 +26,8 @@
 
 #include <sys/types.h>
 
+#include "py_thread.h"
+#include "stack_table.h"
 #include "stats.h"
 
 
@@ -45,6 +47,24 @@ typedef struct {
 
 typedef struct _proc_extra_info proc_extra_info;  // Forward declaration.
 
+
+// Steps of an attach that is carried out with py_proc__attach_step.
+#define ATTACH_MAPS                     0  // Analyse the maps and binaries
+#define ATTACH_VERSION                  1  // Determine the Python version
+#define ATTACH_INTERP                   2  // Locate the interpreter state
+#define ATTACH_DONE                     3
+#define ATTACH_FAILED                   4
+
+
+// A sample of the thread holding the GIL, waiting for its share of the next
+// memory delta.
+typedef struct {
+  char        * stack;
+  py_thread_t   thread;
+  ctime_t       delta;
+} py_sample_t;
+
+
 typedef struct {
   pid_t           pid;
 
@@ -67,15 +87,36 @@ typedef struct {
 
   void          * is_raddr;
 
+  // Processes forked from a common ancestor share the layout of its address
+  // space, and hence its lineage.
+  unsigned int    lineage;
+  int             forked;  // Attached with the analysis of its parent
+
   // Temporal profiling support
   ctime_t         timestamp;
 
+  // Non-blocking attach support
+  int             attach_state;
+  ctime_t         attach_deadline;
+
   // Memory profiling support
   ssize_t         last_resident_memory;
+  ctime_t         mem_timestamp;
+  py_sample_t   * mem_samples;
+  int             mem_sample_count;
+  int             mem_sample_size;
 
   // Offset of the tstate_current field within the _PyRuntimeState structure
   unsigned int    tstate_current_offset;
 
+  // Per-process sampling statistics
+  proc_stats_t    stats;
+
+  // When set, samples are aggregated in the given slot of this table instead
+  // of being printed.
+  stack_table_t * stacks;
+  int             stack_slot;
+
   // Platform-dependent fields
   proc_extra_info * extra;
 } py_proc_t;
@@ -117,6 +158,77 @@ int
 py_proc__attach(py_proc_t *, pid_t, int);
 
 
+/**
+ * Prepare to attach the process with the given PID in steps, so that the
+ * caller can carry on with other work in between. The steps are carried out
+ * with py_proc__attach_step.
+ *
+ * @param py_proc_t *  the process object.
+ * @param pid_t        the PID of the process to attach.
+ *
+ * @return 0 on success.
+ */
+int
+py_proc__attach_start(py_proc_t *, pid_t);
+
+
+/**
+ * Make a single attempt at the current step of the attach, without waiting.
+ * The search for the interpreter state is attempted again on the next call if
+ * unsuccessful, until the start up timeout expires. Any other step that is not
+ * successful makes the attach fail.
+ *
+ * @param py_proc_t *  the process object.
+ *
+ * @return ATTACH_DONE once the process is attached, ATTACH_FAILED if the
+ *         process cannot be attached, or the step to carry out next.
+ */
+int
+py_proc__attach_step(py_proc_t *);
+
+
+#if defined PL_LINUX
+/**
+ * Attach a child process that is a fork of the given parent process, reusing
+ * the results of the analysis of the parent. This fails if the child is not a
+ * fork of the parent, in which case it needs to be attached to from scratch.
+ *
+ * @param py_proc_t *  the process object.
+ * @param pid_t        the PID of the child process.
+ * @param py_proc_t *  the parent process object, or NULL if not available.
+ *
+ * @return 0 on success.
+ */
+int
+py_proc__attach_child(py_proc_t *, pid_t, py_proc_t *);
+
+
+/**
+ * Check that a process attached with py_proc__attach_child is still running
+ * the image of its parent, that is, that it has not called exec since.
+ *
+ * @param py_proc_t *  the process object.
+ *
+ * @return TRUE if the analysis of the parent still applies, FALSE otherwise.
+ */
+int
+py_proc__is_fork_valid(py_proc_t *);
+
+
+/**
+ * Attach a process that only survives as a core file. The binaries that were
+ * mapped by the process must be available at their original paths.
+ *
+ * @param py_proc_t *  the process object.
+ * @param char *       the path of the core file.
+ *
+ * @return 0 on success.
+ */
+int
+py_proc__attach_core(py_proc_t *, const char *);
+#endif
+
+
 /**
  * Get the remote address of the PyInterpreterState instance.
  *
@@ -196,6 +308,19 @@ ssize_t
 py_proc__get_memory_delta(py_proc_t *);
 
 
+/**
+ * Resume sampling after a pause.
+ *
+ * Re-anchor the time and memory baselines so that the first sample after the
+ * pause does not account for the time and memory changes that occurred while
+ * the process was not being sampled.
+ *
+ * @param py_proc_t * the process object.
+ */
+void
+py_proc__resume(py_proc_t *);
+
+
 /**
  * Sample the frame stack of each thread of the given Python process.
  *
@@ -207,6 +332,18 @@ int
 py_proc__sample(py_proc_t *);
 
 
+/**
+ * Print the frame stack of each thread of the given Python process once, in a
+ * readable form.
+ *
+ * @param  py_proc_t *  self.
+
+ * @return 0 if the stacks could be read; 1 otherwise.
+ */
+int
+py_proc__dump(py_proc_t *);
+
+
 /**
  * Get a datatype from the process
  *
@@ -24,6 +24,8 @@
 
 #if defined PL_LINUX
 #include <dirent.h>
+#include <limits.h>
+#include <sys/inotify.h>
 #elif defined PL_MACOS
 #include <libproc.h>
 #define PID_MAX 99999  // From sys/proc_internal.h
@@ -35,6 +37,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 
 #include "hints.h"
 #include "logging.h"
@@ -44,6 +47,8 @@
 
 
 #define UPDATE_INTERVAL           100000  // 0.1s
+#define ATTACH_RETRY_SLEEP           100  // μs
+#define CGROUP_ROOT               "/sys/fs/cgroup"
 
 
 // ----------------------------------------------------------------------------
@@ -87,6 +92,8 @@ _py_proc_list__remove(py_proc_list_t * self, py_proc_item_t * item) {
   pid_t pid = item->py_proc->pid;
   #endif
 
+  proc_stats_log_metrics(&(item->py_proc->stats), item->py_proc->pid);
+
   self->index[item->py_proc->pid] = NULL;
 
   if (item == self->first)
@@ -107,6 +114,160 @@ _py_proc_list__remove(py_proc_list_t * self, py_proc_item_t * item) {
 } /* _py_proc_list__remove */
 
 
+// ----------------------------------------------------------------------------
+// Start attaching to the given process in steps. The process is kept aside
+// until the attach is complete.
+static void
+_py_proc_list__add_attaching(py_proc_list_t * self, py_proc_t * py_proc, pid_t pid) {
+  py_proc_item_t * item = (py_proc_item_t *) malloc(sizeof(py_proc_item_t));
+  if (item == NULL || fail(py_proc__attach_start(py_proc, pid))) {
+    sfree(item);
+    py_proc__destroy(py_proc);
+    return;
+  }
+
+  item->py_proc = py_proc;
+
+  item->next = self->attaching;
+  item->prev = NULL;
+
+  if (self->attaching)
+    self->attaching->prev = item;
+
+  self->attaching = item;
+
+  // Mark the PID as taken so that we do not attempt to attach to it again.
+  self->index[pid] = py_proc;
+} /* _py_proc_list__add_attaching */
+
+
+// ----------------------------------------------------------------------------
+// Carry out the next step of every pending attach. Returns the number of
+// processes that are still being attached to.
+static int
+_py_proc_list__attach_step(py_proc_list_t * self) {
+  int pending = 0;
+
+  for (py_proc_item_t * item = self->attaching; item != NULL; /* item = item->next */) {
+    py_proc_item_t * next  = item->next;
+    int              state = py_proc__attach_step(item->py_proc);
+
+    if (state != ATTACH_DONE && state != ATTACH_FAILED) {
+      pending++;
+      item = next;
+      continue;
+    }
+
+    if (item == self->attaching)
+      self->attaching = next;
+
+    if (next)
+      next->prev = item->prev;
+
+    if (item->prev)
+      item->prev->next = next;
+
+    if (state == ATTACH_DONE)
+      _py_proc_list__add(self, item->py_proc);
+    else {
+      log_d("Cannot attach to process %d", item->py_proc->pid);
+      self->index[item->py_proc->pid] = NULL;
+      py_proc__destroy(item->py_proc);
+    }
+
+    free(item);
+    item = next;
+  }
+
+  return pending;
+} /* _py_proc_list__attach_step */
+
+
+#if defined PL_LINUX
+// ----------------------------------------------------------------------------
+// Attach to the processes in the given cgroup and in all its descendants, and
+// watch them for changes.
+static void
+_py_proc_list__add_cgroup_procs(py_proc_list_t * self, const char * path) {
+  char   file_name[PATH_MAX];
+  pid_t  pid;
+
+  if (self->inotify_fd >= 0)
+    inotify_add_watch(self->inotify_fd, path, IN_CREATE | IN_DELETE | IN_ONLYDIR);
+
+  snprintf(file_name, sizeof(file_name), "%s/cgroup.procs", path);
+  if (self->inotify_fd >= 0)
+    inotify_add_watch(self->inotify_fd, file_name, IN_MODIFY);
+
+  FILE * procs = fopen(file_name, "r");
+  if (procs == NULL)
+    return;
+
+  while (fscanf(procs, "%d", &pid) == 1) {
+    if (pid <= 0 || pid >= self->pids || _py_proc_list__has_pid(self, pid))
+      continue;
+
+    py_proc_t * py_proc = py_proc_new();
+    if (py_proc == NULL)
+      continue;
+
+    _py_proc_list__add_attaching(self, py_proc, pid);
+  }
+
+  fclose(procs);
+
+  DIR * dir = opendir(path);
+  if (dir == NULL)
+    return;
+
+  struct dirent * ent;
+  while ((ent = readdir(dir)) != NULL) {
+    if (ent->d_type != DT_DIR || ent->d_name[0] == '.')
+      continue;
+
+    snprintf(file_name, sizeof(file_name), "%s/%s", path, ent->d_name);
+    _py_proc_list__add_cgroup_procs(self, file_name);
+  }
+
+  closedir(dir);
+} /* _py_proc_list__add_cgroup_procs */
+
+
+// ----------------------------------------------------------------------------
+static int
+_py_proc_list__has_cgroup_events(py_proc_list_t * self) {
+  char buffer[4096];
+  int  has_events = FALSE;
+
+  if (self->inotify_fd < 0)
+    return FALSE;
+
+  // Drain all the pending events.
+  while (read(self->inotify_fd, buffer, sizeof(buffer)) > 0)
+    has_events = TRUE;
+
+  return has_events;
+} /* _py_proc_list__has_cgroup_events */
+
+
+// ----------------------------------------------------------------------------
+static void
+_py_proc_list__update_cgroup(py_proc_list_t * self) {
+  for (py_proc_item_t * item = self->first; item != NULL; /* item = item->next */) {
+    py_proc_item_t * next = item->next;
+    if (!py_proc__is_running(item->py_proc)) {
+      log_d("Process %d no longer running", item->py_proc->pid);
+      py_proc__wait(item->py_proc);
+      _py_proc_list__remove(self, item);
+    }
+    item = next;
+  }
+
+  _py_proc_list__add_cgroup_procs(self, self->cgroup);
+} /* _py_proc_list__update_cgroup */
+#endif
+
+
 // ----------------------------------------------------------------------------
 py_proc_list_t *
 py_proc_list_new(py_proc_t * parent_py_proc) {
@@ -144,13 +305,55 @@ py_proc_list_new(py_proc_t * parent_py_proc) {
     return NULL;
   }
 
-  // Add the parent process to the list.
-  _py_proc_list__add(list, parent_py_proc);
+  // Add the parent process to the list, if any.
+  if (isvalid(parent_py_proc))
+    _py_proc_list__add(list, parent_py_proc);
+
+  #if defined PL_LINUX
+  list->inotify_fd = -1;
+  #endif
 
   return list;
 } /* py_proc_list_new */
 
 
+#if defined PL_LINUX
+// ----------------------------------------------------------------------------
+int
+py_proc_list__set_cgroup(py_proc_list_t * self, const char * path) {
+  char file_name[PATH_MAX];
+
+  if (path[0] == '/')
+    snprintf(file_name, sizeof(file_name), "%s", path);
+  else
+    snprintf(file_name, sizeof(file_name), CGROUP_ROOT "/%s", path);
+
+  // Strip any trailing slashes.
+  size_t len = strlen(file_name);
+  while (len > 1 && file_name[len - 1] == '/')
+    file_name[--len] = '\0';
+
+  self->cgroup = strdup(file_name);
+  if (!isvalid(self->cgroup))
+    FAIL;
+
+  snprintf(file_name, sizeof(file_name), "%s/cgroup.procs", self->cgroup);
+  if (access(file_name, R_OK) != 0) {
+    log_e("Cannot read %s", file_name);
+    FAIL;
+  }
+
+  self->inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+  if (self->inotify_fd < 0)
+    log_w("Cannot watch cgroup %s for changes", self->cgroup);
+
+  log_i("Cgroup: %s", self->cgroup);
+
+  SUCCESS;
+} /* py_proc_list__set_cgroup */
+#endif
+
+
 // ----------------------------------------------------------------------------
 void
 py_proc_list__add_proc_children(py_proc_list_t * self, pid_t ppid) {
@@ -160,12 +363,15 @@ py_proc_list__add_proc_children(py_proc_list_t * self, pid_t ppid) {
       if (child_proc == NULL)
         continue;
 
-      if (py_proc__attach(child_proc, pid, TRUE)) {
-        py_proc__destroy(child_proc);
-        continue;
-      }
+      // Forks of a process that is already attached can be attached to right
+      // away. Any other process is attached to in steps while we sample.
+      #if defined PL_LINUX
+      if (success(py_proc__attach_child(child_proc, pid, self->index[ppid])))
+        _py_proc_list__add(self, child_proc);
+      else
+      #endif
+      _py_proc_list__add_attaching(self, child_proc, pid);
 
-      _py_proc_list__add(self, child_proc);
       py_proc_list__add_proc_children(self, pid);
     }
   }
@@ -175,28 +381,88 @@ py_proc_list__add_proc_children(py_proc_list_t * self, pid_t ppid) {
 // ----------------------------------------------------------------------------
 int
 py_proc_list__is_empty(py_proc_list_t * self) {
-  return self->first == NULL;
+  return self->first == NULL && self->attaching == NULL;
 } /* py_proc_list__is_empty */
 
 
+// ----------------------------------------------------------------------------
+void
+py_proc_list__attach_wait(py_proc_list_t * self) {
+  while (_py_proc_list__attach_step(self))
+    usleep(ATTACH_RETRY_SLEEP);
+} /* py_proc_list__attach_wait */
+
+
 // ----------------------------------------------------------------------------
 void
 py_proc_list__sample(py_proc_list_t * self) {
   log_t("Sampling from process list");
 
+  // Make progress with the pending attaches without holding up the sampling of
+  // the processes that are already attached.
+  if (isvalid(self->attaching))
+    _py_proc_list__attach_step(self);
+
   for (py_proc_item_t * item = self->first; item != NULL; item = item->next) {
     log_t("Sampling process with PID %d", item->py_proc->pid);
     timer_start();
     py_proc__sample(item->py_proc);  // Fail silently
-    timer_stop();
+    proc_stats_record(&(item->py_proc->stats), timer_stop(), error != EOK);
   }
 } /* py_proc_list__sample */
 
 
+// ----------------------------------------------------------------------------
+void
+py_proc_list__dump(py_proc_list_t * self) {
+  py_proc_item_t * last = self->first;
+  if (last == NULL)
+    return;
+
+  while (last->next != NULL)
+    last = last->next;
+
+  // Processes are added at the front of the list, so we go backwards to print
+  // the parents before their children.
+  for (py_proc_item_t * item = last; item != NULL; item = item->prev) {
+    if (!py_proc__is_python(item->py_proc))
+      continue;
+
+    timer_start();
+    if (fail(py_proc__dump(item->py_proc)))
+      log_e("Cannot dump the thread stacks of process %d", item->py_proc->pid);
+    timer_stop();
+  }
+} /* py_proc_list__dump */
+
+
+// ----------------------------------------------------------------------------
+void
+py_proc_list__resume(py_proc_list_t * self) {
+  for (py_proc_item_t * item = self->first; item != NULL; item = item->next)
+    py_proc__resume(item->py_proc);
+} /* py_proc_list__resume */
+
+
 // ----------------------------------------------------------------------------
 void
 py_proc_list__update(py_proc_list_t * self) {
   ctime_t now = gettime();
+
+  #if defined PL_LINUX
+  if (isvalid(self->cgroup)) {
+    // Changes to the cgroup tree are picked up straight away. Processes that
+    // fork within the cgroup do not generate any events, so we rescan the
+    // cgroup periodically anyway.
+    if (now - self->timestamp < UPDATE_INTERVAL && !_py_proc_list__has_cgroup_events(self))
+      return;
+
+    _py_proc_list__update_cgroup(self);
+    self->timestamp = now;
+    return;
+  }
+  #endif
+
   if (now - self->timestamp < UPDATE_INTERVAL)
     return;  // Do not update too frequently as this is an expensive operation.
 
@@ -282,6 +548,19 @@ py_proc_list__update(py_proc_list_t * self) {
 
   // Attach to new PIDs.
   for (py_proc_item_t * item = self->first; item != NULL; /* item = item->next */) {
+    #if defined PL_LINUX
+    // A fork that has called exec is no longer described by the analysis of
+    // its parent. We drop it so that it is attached to again from scratch.
+    if (item->py_proc->forked && !py_proc__is_fork_valid(item->py_proc)) {
+      log_d("Process %d is no longer a fork of its parent", item->py_proc->pid);
+
+      py_proc_item_t * next = item->next;
+      _py_proc_list__remove(self, item);
+      item = next;
+      continue;
+    }
+    #endif
+
     if (py_proc__is_running(item->py_proc)) {
       py_proc_list__add_proc_children(self, item->py_proc->pid);
       item = item->next;
@@ -318,7 +597,21 @@ py_proc_list__destroy(py_proc_list_t * self) {
   while (self->first)
     _py_proc_list__remove(self, self->first);
 
+  while (self->attaching) {
+    py_proc_item_t * next = self->attaching->next;
+    py_proc__destroy(self->attaching->py_proc);
+    free(self->attaching);
+    self->attaching = next;
+  }
+
   sfree(self->index);
   sfree(self->pid_table);
+
+  #if defined PL_LINUX
+  sfree(self->cgroup);
+  if (self->inotify_fd >= 0)
+    close(self->inotify_fd);
+  #endif
+
   free(self);
 } /* py_proc_list__destroy */
@@ -37,11 +37,16 @@ typedef struct _py_proc_item {
 typedef struct {
   int              count;      // Number of entries in the list
   py_proc_item_t * first;      // First item in the list
+  py_proc_item_t * attaching;  // Processes that are still being attached to
   py_proc_t     ** index;      // Index of PIDs in the list
   pid_t          * pid_table;  // Table of pids with their parents
   pid_t            max_pid;    // Highest seen PID in the index
   int              pids;       // Maximum number of PIDs in the index
   ctime_t          timestamp;  // Timestamp of the last update
+  #if defined PL_LINUX
+  char           * cgroup;     // The cgroup to take the processes from, if any
+  int              inotify_fd; // Watches the cgroup tree for changes
+  #endif
 } py_proc_list_t;
 
 
@@ -50,7 +55,7 @@ typedef struct {
  *
  * This list manages the children of the given parent process.
  *
- * @param  py_proc_t  the parent process.
+ * @param  py_proc_t  the parent process, or NULL for an empty list.
  */
 
 py_proc_list_t *
@@ -58,7 +63,8 @@ py_proc_list_new(py_proc_t *);
 
 
 /**
- * Check if the list is empty.
+ * Check if the list is empty, that is, if there are no processes that are
+ * either attached or being attached to.
  *
  * @param  py_proc_list_t  the list.
  *
@@ -68,6 +74,33 @@ int
 py_proc_list__is_empty(py_proc_list_t *);
 
 
+/**
+ * Complete all the pending attaches. New processes are normally attached to
+ * in steps, one on each call to py_proc_list__sample, so that the sampling of
+ * the other processes is not held up.
+ *
+ * @param  py_proc_list_t  the list.
+ */
+void
+py_proc_list__attach_wait(py_proc_list_t *);
+
+
+#if defined PL_LINUX
+/**
+ * Take the processes from the given cgroup, and all its descendants, instead
+ * of from the children of the processes in the list.
+ *
+ * @param  py_proc_list_t  the list.
+ * @param  char *          the cgroup path, either absolute or relative to the
+ *                         root of the cgroup file system.
+ *
+ * @return either SUCCESS or FAIL.
+ */
+int
+py_proc_list__set_cgroup(py_proc_list_t *, const char *);
+#endif
+
+
 /**
  * Add the the children of the given process to the list.
  *
@@ -87,6 +120,24 @@ void
 py_proc_list__sample(py_proc_list_t *);
 
 
+/**
+ * Print the stacks of all the Python processes in the list once.
+ *
+ * @param  py_proc_list_t  the list.
+ */
+void
+py_proc_list__dump(py_proc_list_t *);
+
+
+/**
+ * Resume sampling all the processes in the list after a pause.
+ *
+ * @param  py_proc_list_t  the list.
+ */
+void
+py_proc_list__resume(py_proc_list_t *);
+
+
 /**
  * Update the list.
  *
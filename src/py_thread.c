@@ -20,6 +20,8 @@
 // You should have received a copy of the GNU General Public License
 // along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
+#include <stdarg.h>
+#include <stdio.h>
 #include <string.h>
 
 #include "argparse.h"
@@ -27,6 +29,8 @@
 #include "hints.h"
 #include "logging.h"
 #include "platform.h"
+#include "sink.h"
+#include "stack_table.h"
 #include "version.h"
 
 #include "py_thread.h"
@@ -36,12 +40,19 @@
 
 #define MAX_STACK_SIZE              4096
 #define MAXLEN                      1024
+#define LINE_BUFFER_SIZE            (1 << 16)
+#define METRICS_BUFFER_SIZE         512
+#define CODE_CACHE_SIZE             (1 << 12)  // Must be a power of 2.
+#define STACK_CACHE_SIZE            (1 << 8)   // Must be a power of 2.
 
 
 typedef struct {
+  void       * raddr;
   char         filename [MAXLEN];
   char         scope    [MAXLEN];
+  unsigned int firstlineno;
   unsigned int lineno;
+  int          lasti;
 } py_code_t;
 
 
@@ -57,6 +68,96 @@ typedef struct frame {
 
 py_frame_t * _stack = NULL;
 
+// Buffer for the formatted collapsed stacks. This grows on demand.
+static char * _line      = NULL;
+static size_t _line_size = 0;
+static size_t _line_len  = 0;
+
+// Buffer for the formatted metrics of a sample.
+static char   _metrics[METRICS_BUFFER_SIZE];
+static size_t _metrics_len = 0;
+
+
+// A resolved code object. Together with the resolved strings, we keep the
+// addresses of the objects they were read from, which are used to validate the
+// entry against the remote code object every time it is hit. This catches code
+// objects that have been replaced by others at the same address.
+typedef struct {
+  unsigned int    lineage;
+  void          * raddr;
+  void          * filename_raddr;
+  void          * name_raddr;
+  void          * lnotab_raddr;
+  unsigned int    firstlineno;
+  char          * filename;
+  char          * scope;
+  unsigned char * lnotab;
+  int             lnotab_len;
+  char          * data;  // Single allocation for all of the above.
+} code_cache_entry_t;
+
+
+// Direct-mapped cache of resolved code objects, keyed by the lineage of the
+// process and the address of the code object. Forked processes share the
+// lineage of their parent and hence the entries.
+static code_cache_entry_t * _code_cache   = NULL;
+static unsigned int         _code_lineage = 0;
+
+// Bumped every time a code object is resolved, as the formatted stacks that
+// refer to a code object at the same address might no longer be valid.
+static unsigned int         _code_generation = 0;
+
+
+// The key of a frame within a formatted stack. The code object determines the
+// scope and the file name, and the line number is all that is left.
+typedef struct {
+  void         * code_raddr;
+  unsigned int   lineno;
+} frame_key_t;
+
+
+// The last formatted stack of a thread, together with what it was formatted
+// from. Threads that are idle or blocked tend to show the same stack over and
+// over again, and we can then reuse the formatted stack as is.
+typedef struct {
+  pid_t          pid;
+  uintptr_t      tid;
+  int            cpu;
+  int            node;
+  unsigned int   generation;
+  int            idle;
+  size_t         height;
+  frame_key_t  * frames;
+  size_t         frames_size;
+  char         * line;
+  size_t         line_size;
+} stack_cache_entry_t;
+
+
+// Direct-mapped cache of formatted stacks, keyed by process and thread.
+static stack_cache_entry_t * _stack_cache = NULL;
+
+
+// A local copy of the remote memory around the last frame that was read. The
+// frames of a chain tend to be close to each other, e.g. when they come from
+// the free list, so the next frame is likely to fall within the window.
+static char   * _frame_window      = NULL;
+static void   * _frame_window_addr = NULL;
+static size_t   _frame_window_size = 0;
+static pid_t    _frame_window_pid  = 0;
+
+
+// The own and total time spent on each bytecode instruction, in heat mode.
+#define HEAT_OWN                    0
+#define HEAT_TOTAL                  1
+
+static stack_table_t * _heat = NULL;
+
+// The last sample in which each instruction has been seen, so that recursive
+// calls add to the total time of an instruction only once per sample.
+static stack_table_t * _heat_seen   = NULL;
+static ctime_t         _heat_sample = 0;
+
 
 // ---- PyCode ----------------------------------------------------------------
 
@@ -140,13 +241,21 @@ _get_bytes_from_raddr(pid_t pid, void * raddr, unsigned char * array) {
       goto error;
     }
 
-    len = string.ob_base.ob_size + 1;
+    if ((len = string.ob_base.ob_size + 1) < 1) { // Include null-terminator
+      set_error(ECODEBYTES);
+      goto error;
+    }
+
     if (len >= MAXLEN) {
       // In Python 2.4, the ob_size field is of type int. If we cannot
       // allocate on the first try it's because we are getting a ridiculous
       // value for len. In that case, chop it down to an int and try again.
       // This approach is simpler than adding version support.
       len = (int) len;
+      if (len < 1) {
+        set_error(ECODEBYTES);
+        goto error;
+      }
       if (len >= MAXLEN) {
         log_w("Using MAXLEN when retrieving Bytes object.");
         len = MAXLEN-1;
@@ -190,12 +299,70 @@ error:
 }
 
 
+// ----------------------------------------------------------------------------
+static inline code_cache_entry_t *
+_code_cache__get(void * raddr) {
+  uintptr_t key = ((uintptr_t) raddr >> 4) ^ (_code_lineage * 0x9E3779B1);
+
+  return _code_cache + (key & (CODE_CACHE_SIZE - 1));
+}
+
+
+// ----------------------------------------------------------------------------
+static inline void
+_code_cache_entry__store(
+  code_cache_entry_t * self, void * raddr, PyCodeObject * code,
+  py_code_t * py_code, unsigned char * lnotab, int lnotab_len
+) {
+  size_t filename_len = strlen(py_code->filename) + 1;
+  size_t scope_len    = strlen(py_code->scope) + 1;
+
+  char * data = (char *) realloc(self->data, filename_len + scope_len + lnotab_len);
+  if (!isvalid(data))
+    return;
+
+  self->data       = data;
+  self->filename   = data;
+  self->scope      = data + filename_len;
+  self->lnotab     = (unsigned char *) data + filename_len + scope_len;
+  self->lnotab_len = lnotab_len;
+
+  memcpy(self->filename, py_code->filename, filename_len);
+  memcpy(self->scope, py_code->scope, scope_len);
+  memcpy(self->lnotab, lnotab, lnotab_len);
+
+  self->lineage        = _code_lineage;
+  self->raddr          = raddr;
+  self->filename_raddr = V_FIELD(void *, *code, py_code, o_filename);
+  self->name_raddr     = V_FIELD(void *, *code, py_code, o_name);
+  self->lnotab_raddr   = V_FIELD(void *, *code, py_code, o_lnotab);
+  self->firstlineno    = V_FIELD(unsigned int, *code, py_code, o_firstlineno);
+
+  _code_generation++;
+}
+
+
+// ----------------------------------------------------------------------------
+static inline int
+_code_cache_entry__is_valid(code_cache_entry_t * self, void * raddr, PyCodeObject * code) {
+  return (
+    self->raddr          == raddr
+  &&self->lineage        == _code_lineage
+  &&self->filename_raddr == V_FIELD(void *, *code, py_code, o_filename)
+  &&self->name_raddr     == V_FIELD(void *, *code, py_code, o_name)
+  &&self->lnotab_raddr   == V_FIELD(void *, *code, py_code, o_lnotab)
+  &&self->firstlineno    == V_FIELD(unsigned int, *code, py_code, o_firstlineno)
+  );
+}
+
+
 // ----------------------------------------------------------------------------
 static inline int
 _py_code__fill_from_raddr(py_code_t * self, raddr_t * raddr, int lasti) {
-  PyCodeObject  code;
-  unsigned char lnotab[MAXLEN];
-  int           len;
+  PyCodeObject    code;
+  unsigned char   lnotab_buffer[MAXLEN];
+  unsigned char * lnotab = lnotab_buffer;
+  int             len;
 
   if (self == NULL)
     FAIL;
@@ -205,22 +372,35 @@ _py_code__fill_from_raddr(py_code_t * self, raddr_t * raddr, int lasti) {
     FAIL;
   }
 
-  if (fail(_code__get_filename(&code, raddr->pid, self->filename))) {
-    log_ie("Cannot get file name from PyCodeObject");
-    FAIL;
+  code_cache_entry_t * entry = _code_cache__get(raddr->addr);
+  if (_code_cache_entry__is_valid(entry, raddr->addr, &code)) {
+    strcpy(self->filename, entry->filename);
+    strcpy(self->scope, entry->scope);
+    lnotab = entry->lnotab;
+    len    = entry->lnotab_len;
   }
+  else {
+    if (fail(_code__get_filename(&code, raddr->pid, self->filename))) {
+      log_ie("Cannot get file name from PyCodeObject");
+      FAIL;
+    }
 
-  if (fail(_code__get_name(&code, raddr->pid, self->scope))) {
-    log_ie("Cannot get scope name from PyCodeObject");
-    FAIL;
-  }
+    if (fail(_code__get_name(&code, raddr->pid, self->scope))) {
+      log_ie("Cannot get scope name from PyCodeObject");
+      FAIL;
+    }
 
-  else if ((len = _code__get_lnotab(&code, raddr->pid, lnotab)) < 0 || len % 2) {
-    log_ie("Cannot get line number from PyCodeObject");
-    FAIL;
+    else if ((len = _code__get_lnotab(&code, raddr->pid, lnotab)) < 0 || len % 2) {
+      log_ie("Cannot get line number from PyCodeObject");
+      FAIL;
+    }
+
+    _code_cache_entry__store(entry, raddr->addr, &code, self, lnotab, len);
   }
 
-  int lineno = V_FIELD(unsigned int, code, py_code, o_firstlineno);
+  unsigned int firstlineno = V_FIELD(unsigned int, code, py_code, o_firstlineno);
+
+  int lineno = firstlineno;
   for (register int i = 0, bc = 0; i < len; i++) {
     bc += lnotab[i++];
     if (bc > lasti)
@@ -232,7 +412,10 @@ _py_code__fill_from_raddr(py_code_t * self, raddr_t * raddr, int lasti) {
     lineno += lnotab[i];
   }
 
-  self->lineno = lineno;
+  self->raddr       = raddr->addr;
+  self->firstlineno = firstlineno;
+  self->lineno      = lineno;
+  self->lasti       = lasti;
 
   SUCCESS;
 }
@@ -240,6 +423,51 @@ _py_code__fill_from_raddr(py_code_t * self, raddr_t * raddr, int lasti) {
 
 // ---- PyFrame ---------------------------------------------------------------
 
+// ----------------------------------------------------------------------------
+static inline int
+_frame_window__copy(raddr_t * raddr, void * buf, ssize_t len) {
+  char * addr = (char *) raddr->addr;
+  char * base = (char *) _frame_window_addr;
+
+  if (!isvalid(_frame_window) || len > (ssize_t) pargs.frame_window)
+    return copy_memory(raddr->pid, raddr->addr, len, buf);
+
+  if (
+    isvalid(base) && raddr->pid == _frame_window_pid &&
+    addr >= base && addr + len <= base + _frame_window_size
+  ) {
+    memcpy(buf, _frame_window + (addr - base), len);
+    stats_count_frame_window_hit();
+    SUCCESS;
+  }
+
+  stats_count_frame_window_miss();
+
+  // Read the aligned window that contains the frame, or the two of them if
+  // the frame straddles a window boundary.
+  base = (char *) ((uintptr_t) addr & ~((uintptr_t) pargs.frame_window - 1));
+  size_t size = addr + len <= base + pargs.frame_window
+    ? pargs.frame_window
+    : pargs.frame_window << 1;
+  error_t last_error = error;
+  if (fail(copy_memory(raddr->pid, base, size, _frame_window))) {
+    // The window might reach into unmapped memory. This is not an error, as
+    // long as the frame itself can be read.
+    error = last_error;
+    _frame_window_addr = NULL;
+    return copy_memory(raddr->pid, raddr->addr, len, buf);
+  }
+
+  _frame_window_addr = base;
+  _frame_window_size = size;
+  _frame_window_pid  = raddr->pid;
+
+  memcpy(buf, _frame_window + (addr - base), len);
+
+  SUCCESS;
+}
+
+
 // ----------------------------------------------------------------------------
 static inline int
 _py_frame__fill_from_raddr(py_frame_t * self, raddr_t * raddr) {
@@ -247,7 +475,7 @@ _py_frame__fill_from_raddr(py_frame_t * self, raddr_t * raddr) {
 
   self->invalid = 1;
 
-  if (fail(copy_from_raddr_v(raddr, frame, py_v->py_frame.size))) {
+  if (fail(_frame_window__copy(raddr, &frame, py_v->py_frame.size))) {
     log_ie("Cannot read remote PyFrameObject");
     FAIL;
   }
@@ -300,6 +528,9 @@ py_thread__fill_from_raddr(py_thread_t * self, raddr_t * raddr) {
   self->invalid      = 1;
   self->stack_height = 0;
 
+  // The window is only good for a single walk of the frame stack.
+  _frame_window_addr = NULL;
+
   if (fail(copy_from_raddr(raddr, ts))) {
     log_ie("Cannot read remote PyThreadState");
     FAIL;
@@ -358,51 +589,318 @@ py_thread__next(py_thread_t * self) {
 #if defined PL_WIN
   #define SAMPLE_HEAD "P%I64d;T%I64x"
   #define MEM_METRIC " %I64d"
+  #define DUMP_HEAD "  Thread 0x%I64x\n"
 #else
   #define SAMPLE_HEAD "P%d;T%lx"
   #define MEM_METRIC " %ld"
+  #define DUMP_HEAD "  Thread 0x%lx\n"
 #endif
 
-void
-py_thread__print_collapsed_stack(py_thread_t * self, ctime_t delta, ssize_t mem_delta) {
-  if (!pargs.full && pargs.memory && mem_delta <= 0)
-    return;
+static int
+_line__printf(const char * fmt, ...) {
+  va_list args;
+  int     len;
+
+  for (;;) {
+    va_start(args, fmt);
+    len = vsnprintf(_line + _line_len, _line_size - _line_len, fmt, args);
+    va_end(args);
+
+    if (len < 0)
+      FAIL;
+
+    if (_line_len + len < _line_size)
+      break;
+
+    char * line = (char *) realloc(_line, _line_size << 1);
+    if (!isvalid(line))
+      FAIL;
+    _line       = line;
+    _line_size <<= 1;
+  }
+
+  _line_len += len;
+
+  SUCCESS;
+}
+
+
+// ----------------------------------------------------------------------------
+static inline stack_cache_entry_t *
+_stack_cache__get(py_thread_t * thread) {
+  uintptr_t key = (thread->tid >> 4) ^ ((uintptr_t) thread->raddr.pid * 0x9E3779B1);
+
+  return _stack_cache + (key & (STACK_CACHE_SIZE - 1));
+}
+
+
+// ----------------------------------------------------------------------------
+static inline int
+_stack_cache_entry__is_valid(stack_cache_entry_t * self, py_thread_t * thread) {
+  if (!(
+    isvalid(self->line)
+  &&self->tid        == thread->tid
+  &&self->pid        == thread->raddr.pid
+  &&self->height     == thread->stack_height
+  &&self->generation == _code_generation
+  &&(!pargs.numa || (self->cpu == thread->cpu && self->node == thread->node))
+  ))
+    return FALSE;
+
+  for (register size_t i = 0; i < self->height; i++) {
+    if (
+      self->frames[i].code_raddr != _stack[i].code.raddr
+    ||self->frames[i].lineno     != _stack[i].code.lineno
+    )
+      return FALSE;
+  }
+
+  return TRUE;
+}
+
 
+// ----------------------------------------------------------------------------
+static inline void
+_stack_cache_entry__store(stack_cache_entry_t * self, py_thread_t * thread, int idle) {
+  if (self->frames_size < thread->stack_height) {
+    frame_key_t * frames = (frame_key_t *) realloc(self->frames, thread->stack_height * sizeof(frame_key_t));
+    if (!isvalid(frames))
+      goto invalidate;
+    self->frames      = frames;
+    self->frames_size = thread->stack_height;
+  }
+
+  if (self->line_size < _line_len + 1) {
+    char * line = (char *) realloc(self->line, _line_len + 1);
+    if (!isvalid(line))
+      goto invalidate;
+    self->line      = line;
+    self->line_size = _line_len + 1;
+  }
+
+  for (register size_t i = 0; i < thread->stack_height; i++) {
+    self->frames[i].code_raddr = _stack[i].code.raddr;
+    self->frames[i].lineno     = _stack[i].code.lineno;
+  }
+  memcpy(self->line, _line, _line_len + 1);
+
+  self->pid        = thread->raddr.pid;
+  self->tid        = thread->tid;
+  self->cpu        = thread->cpu;
+  self->node       = thread->node;
+  self->height     = thread->stack_height;
+  self->generation = _code_generation;
+  self->idle       = idle;
+
+  return;
+
+invalidate:
+  self->tid = 0;
+}
+
+
+// ----------------------------------------------------------------------------
+const char *
+py_thread__format_collapsed_stack(py_thread_t * self, ctime_t * delta) {
   if (self->invalid)
-    return;
+    return NULL;
 
   if (self->stack_height == 0 && pargs.exclude_empty)
     // Skip if thread has no frames and we want to exclude empty threads
-    return;
+    return NULL;
+
+  // Reuse the formatted stack from the previous sample if nothing has changed.
+  stack_cache_entry_t * entry = _stack_cache__get(self);
+  if (_stack_cache_entry__is_valid(entry, self)) {
+    if (entry->idle)
+      *delta = 0;
+    return entry->line;
+  }
+
+  int idle = FALSE;
+
+  _line_len = 0;
 
   // Group entries by thread.
-  fprintf(pargs.output_file, SAMPLE_HEAD, self->raddr.pid, self->tid);
+  _line__printf(SAMPLE_HEAD, self->raddr.pid, self->tid);
+
+  if (pargs.numa && self->cpu >= 0)
+    _line__printf(";N%d;C%d", self->node, self->cpu);
 
   if (self->stack_height) {
     // Append frames
     register int i = self->stack_height;
     while(i > 0) {
-      py_code_t code = _stack[--i].code;
-      if (pargs.sleepless && strstr(code.scope, "wait") != NULL) {
-        delta = 0;
-        fprintf(pargs.output_file, ";<idle>");
+      py_code_t * code = &(_stack[--i].code);
+      if (pargs.sleepless && strstr(code->scope, "wait") != NULL) {
+        *delta = 0;
+        idle   = TRUE;
+        _line__printf(";<idle>");
         break;
       }
-      fprintf(pargs.output_file, pargs.format, code.scope, code.filename, code.lineno);
+      _line__printf(pargs.format, code->scope, code->filename, code->lineno);
     }
   }
-  // Finish off sample with the metric(s)
+
+  _stack_cache_entry__store(entry, self, idle);
+
+  return _line;
+}
+
+
+// ----------------------------------------------------------------------------
+// In memory mode, only the samples that show some memory growth are reported.
+static inline int
+_py_thread__is_memory_sample(py_thread_t * self, ssize_t mem_delta) {
+  return mem_delta > 0 || (
+    pargs.smaps && (self->mem.anon > 0 || self->mem.file > 0 || self->mem.shmem > 0)
+  );
+}
+
+
+// ----------------------------------------------------------------------------
+static int
+_metrics__printf(const char * fmt, ...) {
+  va_list args;
+  int     len;
+
+  va_start(args, fmt);
+  len = vsnprintf(_metrics + _metrics_len, METRICS_BUFFER_SIZE - _metrics_len, fmt, args);
+  va_end(args);
+
+  if (len > 0)
+    _metrics_len += len;
+  if (_metrics_len >= METRICS_BUFFER_SIZE)
+    _metrics_len = METRICS_BUFFER_SIZE - 1;
+
+  return len;
+}
+
+
+// ----------------------------------------------------------------------------
+// Format the metric(s) once, so that they can be fanned out to all the sinks.
+static void
+_py_thread__format_metrics(py_thread_t * self, ctime_t delta, ssize_t mem_delta) {
+  _metrics_len = 0;
+
   if (pargs.full) {
-    fprintf(pargs.output_file, " %lu" MEM_METRIC MEM_METRIC "\n",
+    _metrics__printf(" %lu" MEM_METRIC MEM_METRIC,
       delta, mem_delta >= 0 ? mem_delta : 0, mem_delta < 0 ? mem_delta : 0
     );
   }
   else {
     if (pargs.memory)
-      fprintf(pargs.output_file, MEM_METRIC "\n", mem_delta);
+      _metrics__printf(MEM_METRIC, mem_delta);
     else
-      fprintf(pargs.output_file, " %lu\n", delta);
+      _metrics__printf(" %lu", delta);
   }
+
+  if (pargs.smaps)
+    _metrics__printf(MEM_METRIC MEM_METRIC MEM_METRIC,
+      self->mem.anon, self->mem.file, self->mem.shmem
+    );
+
+  // Append the task metrics, if requested.
+  if (pargs.faults)
+    _metrics__printf(" %lu %lu", self->minflt, self->majflt);
+  if (pargs.ctx_switches)
+    _metrics__printf(" %lu %lu", self->vcsw, self->ivcsw);
+  if (pargs.io)
+    _metrics__printf(" %lu %lu", self->rchar, self->wchar);
+
+  _metrics__printf("\n");
+}
+
+
+// ----------------------------------------------------------------------------
+void
+py_thread__print_sample(py_thread_t * self, const char * stack, ctime_t delta, ssize_t mem_delta) {
+  if (!pargs.full && pargs.memory && !_py_thread__is_memory_sample(self, mem_delta))
+    return;
+
+  _py_thread__format_metrics(self, delta, mem_delta);
+  sinks_sample(stack, _metrics, delta, mem_delta);
+}
+
+
+// ----------------------------------------------------------------------------
+void
+py_thread__print_collapsed_stack(py_thread_t * self, ctime_t delta, ssize_t mem_delta) {
+  if (!pargs.full && pargs.memory && !_py_thread__is_memory_sample(self, mem_delta))
+    return;
+
+  const char * stack = py_thread__format_collapsed_stack(self, &delta);
+  if (!isvalid(stack))
+    return;
+
+  _py_thread__format_metrics(self, delta, mem_delta);
+  sinks_sample(stack, _metrics, delta, mem_delta);
+}
+
+
+// ----------------------------------------------------------------------------
+void
+py_thread__print_stack(py_thread_t * self) {
+  if (self->invalid || (self->stack_height == 0 && pargs.exclude_empty))
+    return;
+
+  fprintf(pargs.output_file, DUMP_HEAD, self->tid);
+
+  if (self->stack_height == 0)
+    fputs("    <no frames>\n", pargs.output_file);
+
+  // Most recent call first.
+  for (register int i = 0; i < self->stack_height; i++) {
+    py_code_t * code = &(_stack[i].code);
+    fprintf(pargs.output_file, "    %s (%s:%d)\n", code->scope, code->filename, code->lineno);
+  }
+}
+
+
+// ----------------------------------------------------------------------------
+void
+py_thread__add_heat(py_thread_t * self, ctime_t delta) {
+  char key[MAXLEN * 2 + 64];
+
+  if (self->invalid || self->stack_height == 0 || !isvalid(_heat))
+    return;
+
+  if (pargs.sleepless) {
+    for (register int i = 0; i < self->stack_height; i++)
+      if (strstr(_stack[i].code.scope, "wait") != NULL)
+        return;
+  }
+
+  _heat_sample++;
+
+  // The most recent frame is the one executing the instruction.
+  for (register int i = 0; i < self->stack_height; i++) {
+    py_code_t * code = &(_stack[i].code);
+    int len = snprintf(key, sizeof(key), pargs.format + 1,
+      code->scope, code->filename, code->lineno
+    );
+    // Functions with the same name in the same file, like the __init__ of
+    // different classes, are told apart by their first line.
+    snprintf(key + len, sizeof(key) - len, ";F%u;I%d", code->firstlineno, code->lasti);
+
+    if (i == 0)
+      stack_table__add(_heat, key, HEAT_OWN, delta);
+
+    stack_entry_t * seen = stack_table__get(_heat_seen, key);
+    if (!isvalid(seen) || seen->values[0] == _heat_sample)
+      continue;
+    seen->values[0] = _heat_sample;
+
+    stack_table__add(_heat, key, HEAT_TOTAL, delta);
+  }
+}
+
+
+// ----------------------------------------------------------------------------
+void
+py_thread_print_heat(void) {
+  if (isvalid(_heat))
+    stack_table__print(_heat, pargs.output_file, STACK_TABLE_SLOTS);
 }
 
 
@@ -413,7 +911,68 @@ py_thread_allocate_stack(void) {
     SUCCESS;
 
   _stack = (py_frame_t *) calloc(MAX_STACK_SIZE, sizeof(py_frame_t));
-  return _stack == NULL;
+  if (!isvalid(_stack))
+    FAIL;
+
+  _line = (char *) malloc(LINE_BUFFER_SIZE);
+  if (!isvalid(_line)) {
+    sfree(_stack);
+    FAIL;
+  }
+  _line_size = LINE_BUFFER_SIZE;
+
+  _code_cache = (code_cache_entry_t *) calloc(CODE_CACHE_SIZE, sizeof(code_cache_entry_t));
+  if (!isvalid(_code_cache)) {
+    sfree(_stack);
+    sfree(_line);
+    FAIL;
+  }
+
+  _stack_cache = (stack_cache_entry_t *) calloc(STACK_CACHE_SIZE, sizeof(stack_cache_entry_t));
+  if (!isvalid(_stack_cache)) {
+    sfree(_stack);
+    sfree(_line);
+    sfree(_code_cache);
+    FAIL;
+  }
+
+  if (pargs.heat) {
+    _heat      = stack_table_new();
+    _heat_seen = stack_table_new();
+    if (!isvalid(_heat) || !isvalid(_heat_seen)) {
+      stack_table__destroy(_heat);
+      stack_table__destroy(_heat_seen);
+      _heat = _heat_seen = NULL;
+      sfree(_stack);
+      sfree(_line);
+      sfree(_code_cache);
+      sfree(_stack_cache);
+      FAIL;
+    }
+  }
+
+  if (pargs.frame_window) {
+    _frame_window = (char *) malloc(pargs.frame_window << 1);
+    if (!isvalid(_frame_window)) {
+      sfree(_stack);
+      sfree(_line);
+      sfree(_code_cache);
+      sfree(_stack_cache);
+      stack_table__destroy(_heat);
+      stack_table__destroy(_heat_seen);
+      _heat = _heat_seen = NULL;
+      FAIL;
+    }
+  }
+
+  SUCCESS;
+}
+
+
+// ----------------------------------------------------------------------------
+void
+py_thread_set_lineage(unsigned int lineage) {
+  _code_lineage = lineage;
 }
 
 
@@ -421,4 +980,27 @@ py_thread_allocate_stack(void) {
 void
 py_thread_free_stack(void) {
   sfree(_stack);
+  sfree(_line);
+  _line_size = 0;
+
+  if (isvalid(_code_cache)) {
+    for (register int i = 0; i < CODE_CACHE_SIZE; i++)
+      sfree(_code_cache[i].data);
+    sfree(_code_cache);
+  }
+
+  if (isvalid(_stack_cache)) {
+    for (register int i = 0; i < STACK_CACHE_SIZE; i++) {
+      sfree(_stack_cache[i].frames);
+      sfree(_stack_cache[i].line);
+    }
+    sfree(_stack_cache);
+  }
+
+  stack_table__destroy(_heat);
+  stack_table__destroy(_heat_seen);
+  _heat = _heat_seen = NULL;
+
+  sfree(_frame_window);
+  _frame_window_addr = NULL;
 }
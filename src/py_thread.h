@@ -30,6 +30,14 @@
 #include "stats.h"
 
 
+// Breakdown of a memory delta, as read from smaps_rollup (Linux only).
+typedef struct {
+  ssize_t         anon;
+  ssize_t         file;
+  ssize_t         shmem;
+} mem_breakdown_t;
+
+
 typedef struct thread {
   raddr_t         raddr;
   raddr_t         next_raddr;
@@ -40,6 +48,20 @@ typedef struct thread {
   size_t          stack_height;
 
   int             invalid;
+
+  // Task metrics, as deltas since the previous sample of the thread. These
+  // are collected by the process on demand (Linux only).
+  ustat_t         minflt;
+  ustat_t         majflt;
+  ustat_t         vcsw;
+  ustat_t         ivcsw;
+  ustat_t         rchar;
+  ustat_t         wchar;
+  int             cpu;
+  int             node;
+
+  // Breakdown of the memory delta attributed to the thread.
+  mem_breakdown_t mem;
 } py_thread_t;
 
 
@@ -64,6 +86,34 @@ int
 py_thread__next(py_thread_t *);
 
 
+/**
+ * Format the frame stack of the thread using the collapsed format, without
+ * the metrics.
+ *
+ * @param  py_thread_t  self.
+ * @param  ctime_t      the time delta. This is set to 0 if the thread is
+ *                      idle and idle frames are not wanted.
+ *
+ * @return the formatted stack, or NULL if the thread should not be reported.
+ *         The returned buffer is reused by the next call.
+ */
+const char *
+py_thread__format_collapsed_stack(py_thread_t *, ctime_t *);
+
+
+/**
+ * Print a sample of the thread, made of a stack formatted with
+ * py_thread__format_collapsed_stack and of the given metrics.
+ *
+ * @param  py_thread_t  self.
+ * @param  char *       the formatted stack.
+ * @param  ctime_t      the time delta.
+ * @param  ssize_t      the memory delta.
+ */
+void
+py_thread__print_sample(py_thread_t *, const char *, ctime_t, ssize_t);
+
+
 /**
  * Print the frame stack using the collapsed format.
  *
@@ -75,6 +125,36 @@ void
 py_thread__print_collapsed_stack(py_thread_t *, ctime_t, ssize_t);
 
 
+/**
+ * Print the frame stack in a readable form, one frame per line, starting from
+ * the most recent call.
+ *
+ * @param  py_thread_t  self.
+ */
+void
+py_thread__print_stack(py_thread_t *);
+
+
+/**
+ * Add the time delta to the bytecode instructions that the frames of the
+ * thread are executing. Every frame adds to the total time of its instruction,
+ * whereas only the most recent one adds to the own time.
+ *
+ * @param  py_thread_t  self.
+ * @param  ctime_t      the time delta.
+ */
+void
+py_thread__add_heat(py_thread_t *, ctime_t);
+
+
+/**
+ * Print the own and total time collected for each bytecode instruction with
+ * py_thread__add_heat.
+ */
+void
+py_thread_print_heat(void);
+
+
 /**
  * Allocate memory for dumping the frame stack.
  *
@@ -91,4 +171,15 @@ void
 py_thread_free_stack(void);
 
 
+/**
+ * Set the lineage of the process whose threads are about to be read. Resolved
+ * code objects are shared among the processes with the same lineage, that is,
+ * among processes that have been forked from a common ancestor.
+ *
+ * @param  unsigned int  the lineage.
+ */
+void
+py_thread_set_lineage(unsigned int);
+
+
 #endif // PY_THREAD_H
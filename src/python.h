@@ -282,9 +282,52 @@ typedef struct _ts3_4 {
 } PyThreadState3_4;
 
 
+typedef struct _err_stackitem3_7 {
+    PyObject *exc_type, *exc_value, *exc_traceback;
+
+    struct _err_stackitem3_7 *previous_item;
+} _PyErr_StackItem3_7;
+
+
+typedef struct _ts3_7 {
+    struct _ts3_7 *prev;
+    struct _ts3_7 *next;
+    PyInterpreterState *interp;
+
+    struct _frame *frame;
+    int recursion_depth;
+    char overflowed;
+    char recursion_critical;
+    int stackcheck_counter;
+
+    int tracing;
+    int use_tracing;
+
+    Py_tracefunc c_profilefunc;
+    Py_tracefunc c_tracefunc;
+    PyObject *c_profileobj;
+    PyObject *c_traceobj;
+
+    PyObject *curexc_type;
+    PyObject *curexc_value;
+    PyObject *curexc_traceback;
+
+    _PyErr_StackItem3_7 exc_state;
+    _PyErr_StackItem3_7 *exc_info;
+
+    PyObject *dict;  /* Stores per-thread state */
+
+    int gilstate_counter;
+
+    PyObject *async_exc; /* Asynchronous exception to raise */
+    unsigned long thread_id; /* Thread id where this tstate was created */
+} PyThreadState3_7;
+
+
 typedef union {
   PyThreadState2   v2;
   PyThreadState3_4 v3_4;
+  PyThreadState3_7 v3_7;
 } PyThreadState;
 
 // ---- internal/pystate.h ----------------------------------------------------
@@ -0,0 +1,464 @@
+// This file is part of "austin" which is released under GPL.
+//
+// See file LICENCE or go to http://www.gnu.org/licenses/ for full license
+// details.
+//
+// Austin is a Python frame stack sampler for CPython.
+//
+// Copyright (c) 2018 Gabriele N. Tornetta <phoenix1987@gmail.com>.
+// All rights reserved.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "platform.h"
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined PL_UNIX
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+#include "aggregator.h"
+#include "argparse.h"
+#include "error.h"
+#include "hints.h"
+#include "logging.h"
+#include "sql.h"
+#include "stack_table.h"
+
+#include "sink.h"
+
+
+#define SINK_BUFFER_SIZE           (1 << 20)
+#define SINK_FLUSH_SIZE            (1 << 12)
+#define SINK_FLUSH_INTERVAL           100000  // Flush streams every 0.1s.
+#define SINK_COMMENT_SIZE                256
+
+
+typedef struct {
+  int             kind;
+  const char    * path;
+  FILE          * file;
+  int             owns_file;
+
+  // Streams to FIFOs and to aggregators are written to without blocking, from
+  // a buffer of their own, so that a slow consumer cannot stall the others.
+  // When the buffer is full, the samples are dropped.
+  int             fd;
+  char          * buffer;
+  size_t          len;
+  ctime_t         flush_time;
+  ustat_t         dropped;
+
+  stack_table_t * stacks;  // Aggregated sinks only.
+  sql_t         * sql;     // SQL sinks only.
+} sink_t;
+
+
+static const char * _sink_kinds[] = {"collapsed", "aggregated", "sql", "unix", NULL};
+
+static sink_t       _sinks[MAX_SINKS + 1];
+static int          _n_sinks = 0;
+static const char * _service = NULL;
+
+
+// ---- PRIVATE ---------------------------------------------------------------
+
+// ----------------------------------------------------------------------------
+static void
+_sink__flush(sink_t * self) {
+  if (!isvalid(self->buffer)) {
+    if (isvalid(self->file))
+      fflush(self->file);
+    return;
+  }
+
+  #if defined PL_UNIX
+  size_t written = 0;
+
+  while (self->fd >= 0 && written < self->len) {
+    ssize_t n = write(self->fd, self->buffer + written, self->len - written);
+    if (n < 0) {
+      if (errno == EINTR)
+        continue;
+      if (errno != EAGAIN && errno != EWOULDBLOCK) {
+        log_w("Output sink %s closed by the consumer", self->path);
+        close(self->fd);
+        self->fd = -1;
+      }
+      break;
+    }
+    written += n;
+  }
+
+  if (self->fd < 0)
+    written = self->len;
+
+  memmove(self->buffer, self->buffer + written, self->len - written);
+  self->len       -= written;
+  self->flush_time = gettime();
+  #endif
+} /* _sink__flush */
+
+
+// ----------------------------------------------------------------------------
+static void
+_sink__stream(sink_t * self, const char * stack, const char * metrics) {
+  size_t stack_len   = strlen(stack);
+  size_t metrics_len = strlen(metrics);
+
+  if (self->fd < 0)
+    return;
+
+  if (self->len + stack_len + metrics_len > SINK_BUFFER_SIZE) {
+    _sink__flush(self);
+    if (self->len + stack_len + metrics_len > SINK_BUFFER_SIZE) {
+      self->dropped++;
+      return;
+    }
+  }
+
+  memcpy(self->buffer + self->len, stack, stack_len);
+  self->len += stack_len;
+  memcpy(self->buffer + self->len, metrics, metrics_len);
+  self->len += metrics_len;
+
+  if (self->len >= SINK_FLUSH_SIZE || gettime() - self->flush_time >= SINK_FLUSH_INTERVAL)
+    _sink__flush(self);
+} /* _sink__stream */
+
+
+// ----------------------------------------------------------------------------
+static int
+_sink__connect(sink_t * self, const char * path) {
+  #if defined PL_UNIX
+  struct sockaddr_un addr;
+
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  if (strlen(path) >= sizeof(addr.sun_path)) {
+    log_e("Socket path %s is too long", path);
+    FAIL;
+  }
+  strcpy(addr.sun_path, path);
+
+  if (
+    (self->fd = socket(AF_UNIX, SOCK_STREAM, 0)) < 0 ||
+    connect(self->fd, (struct sockaddr *) &addr, sizeof(addr)) != 0
+  ) {
+    log_e("Cannot connect to the aggregator on %s", path);
+    FAIL;
+  }
+  fcntl(self->fd, F_SETFL, fcntl(self->fd, F_GETFL) | O_NONBLOCK);
+
+  if (!isvalid(self->buffer = (char *) malloc(SINK_BUFFER_SIZE)))
+    FAIL;
+  self->flush_time = gettime();
+
+  signal(SIGPIPE, SIG_IGN);
+
+  // Tell the aggregator which service the samples that follow belong to.
+  self->len = snprintf(
+    self->buffer, SINK_COMMENT_SIZE, AGGREGATOR_SERVICE "%s\n", _service
+  );
+
+  log_i("Output sink: %s (%s, service %s)", path, _sink_kinds[self->kind], _service);
+
+  SUCCESS;
+
+  #else
+  log_e("Unix sockets are not supported on this platform");
+  FAIL;
+  #endif
+} /* _sink__connect */
+
+
+// ----------------------------------------------------------------------------
+static int
+_sink__open(sink_t * self, int kind, const char * path, FILE * file) {
+  self->kind = kind;
+  self->path = path;
+  self->fd   = -1;
+
+  if (kind == SINK_UNIX)
+    return _sink__connect(self, path);
+
+  if (isvalid(file) || strcmp(path, "-") == 0) {
+    self->file = isvalid(file) ? file : stdout;
+  }
+  else {
+    #if defined PL_UNIX
+    struct stat st;
+    if (stat(path, &st) == 0 && S_ISFIFO(st.st_mode)) {
+      // Opening the FIFO without blocking fails when there is no consumer.
+      if ((self->fd = open(path, O_WRONLY | O_NONBLOCK)) < 0) {
+        log_e("Cannot open FIFO %s for writing", path);
+        FAIL;
+      }
+
+      if (kind == SINK_COLLAPSED) {
+        if (!isvalid(self->buffer = (char *) malloc(SINK_BUFFER_SIZE))) {
+          close(self->fd);
+          FAIL;
+        }
+        self->flush_time = gettime();
+
+        // A consumer that goes away must not take us down with it.
+        signal(SIGPIPE, SIG_IGN);
+      }
+      else {
+        // The other sinks are written at the end, or are meant to be loaded
+        // in full, so they can block.
+        fcntl(self->fd, F_SETFL, fcntl(self->fd, F_GETFL) & ~O_NONBLOCK);
+        if (!isvalid(self->file = fdopen(self->fd, "w"))) {
+          close(self->fd);
+          FAIL;
+        }
+        self->fd        = -1;
+        self->owns_file = TRUE;
+      }
+    }
+    else
+    #endif
+    {
+      if (!isvalid(self->file = fopen(path, "w"))) {
+        log_e("Cannot open output file %s", path);
+        FAIL;
+      }
+      self->owns_file = TRUE;
+    }
+  }
+
+  if (kind == SINK_AGGREGATED && !isvalid(self->stacks = stack_table_new()))
+    FAIL;
+
+  if (kind == SINK_SQL && !isvalid(self->sql = sql_new(self->file)))
+    FAIL;
+
+  log_i("Output sink: %s (%s)", path, _sink_kinds[kind]);
+
+  SUCCESS;
+} /* _sink__open */
+
+
+// ----------------------------------------------------------------------------
+static void
+_sink__close(sink_t * self) {
+  switch (self->kind) {
+  case SINK_AGGREGATED:
+    if (isvalid(self->stacks)) {
+      stack_table__print(self->stacks, self->file, 1);
+      stack_table__destroy(self->stacks);
+    }
+    break;
+
+  case SINK_SQL:
+    sql__destroy(self->sql);
+    break;
+  }
+
+  _sink__flush(self);
+
+  if (self->dropped)
+    log_w("Output sink %s dropped %lu samples", self->path, self->dropped);
+
+  #if defined PL_UNIX
+  if (self->fd >= 0)
+    close(self->fd);
+  #endif
+  sfree(self->buffer);
+
+  if (self->owns_file && isvalid(self->file))
+    fclose(self->file);
+
+  memset(self, 0, sizeof(sink_t));
+} /* _sink__close */
+
+
+// ---- PUBLIC ----------------------------------------------------------------
+
+// ----------------------------------------------------------------------------
+int
+sink_kind(const char * spec) {
+  const char * colon = strchr(spec, ':');
+  if (!isvalid(colon) || *(colon + 1) == '\0')
+    return -1;
+
+  for (register int i = 0; _sink_kinds[i] != NULL; i++) {
+    if (
+      strlen(_sink_kinds[i]) == (size_t) (colon - spec) &&
+      strncmp(spec, _sink_kinds[i], colon - spec) == 0
+    )
+      return i;
+  }
+
+  return -1;
+} /* sink_kind */
+
+
+// ----------------------------------------------------------------------------
+int
+sinks_open(const char * service) {
+  _n_sinks = 0;
+  _service = service;
+
+  // The main output is a sink too, unless it has been replaced by other sinks.
+  if (pargs.n_sinks == 0 || pargs.output_filename != NULL) {
+    if (fail(_sink__open(
+      &_sinks[_n_sinks++],
+      pargs.sql ? SINK_SQL : SINK_COLLAPSED,
+      pargs.output_filename != NULL ? pargs.output_filename : "-",
+      pargs.output_file != NULL ? pargs.output_file : stdout
+    )))
+      goto error;
+  }
+
+  for (register int i = 0; i < pargs.n_sinks; i++) {
+    const char * spec = pargs.sinks[i];
+    if (fail(_sink__open(
+      &_sinks[_n_sinks++], sink_kind(spec), strchr(spec, ':') + 1, NULL
+    )))
+      goto error;
+  }
+
+  SUCCESS;
+
+error:
+  sinks_close();
+  set_error(ESINK);
+  FAIL;
+} /* sinks_open */
+
+
+// ----------------------------------------------------------------------------
+void
+sinks_sample(const char * stack, const char * metrics, ctime_t time, ssize_t memory) {
+  char value[32];
+
+  for (register int i = 0; i < _n_sinks; i++) {
+    sink_t * sink = &_sinks[i];
+
+    switch (sink->kind) {
+    case SINK_COLLAPSED:
+      if (isvalid(sink->buffer))
+        _sink__stream(sink, stack, metrics);
+      else {
+        fputs(stack, sink->file);
+        fputs(metrics, sink->file);
+      }
+      break;
+
+    case SINK_AGGREGATED:
+      // Only the first metric is aggregated.
+      stack_table__add(sink->stacks, stack, 0,
+        pargs.memory && !pargs.full ? (ctime_t) memory : time
+      );
+      break;
+
+    case SINK_SQL:
+      sql__add_sample(sink->sql, stack, time, memory);
+      break;
+
+    case SINK_UNIX:
+      // Aggregators too only get the first metric.
+      sprintf(value, " %ld\n", pargs.memory && !pargs.full ? (long) memory : (long) time);
+      _sink__stream(sink, stack, value);
+      break;
+    }
+  }
+} /* sinks_sample */
+
+
+// ----------------------------------------------------------------------------
+void
+sinks_comment(const char * fmt, ...) {
+  char    comment[SINK_COMMENT_SIZE];
+  va_list args;
+
+  va_start(args, fmt);
+  vsnprintf(comment, sizeof(comment), fmt, args);
+  va_end(args);
+
+  for (register int i = 0; i < _n_sinks; i++) {
+    sink_t * sink = &_sinks[i];
+    if (sink->kind != SINK_COLLAPSED)
+      continue;
+
+    if (isvalid(sink->buffer))
+      _sink__stream(sink, comment, "");
+    else
+      fputs(comment, sink->file);
+  }
+} /* sinks_comment */
+
+
+// ----------------------------------------------------------------------------
+void
+sinks_marker(const char * label) {
+  char marker[SINK_COMMENT_SIZE];
+
+  // The time has the same reference as the burst markers.
+  snprintf(marker, sizeof(marker), SINK_MARKER "%s @ %luus\n", label, gettime());
+
+  for (register int i = 0; i < _n_sinks; i++) {
+    sink_t * sink = &_sinks[i];
+
+    switch (sink->kind) {
+    case SINK_COLLAPSED:
+    case SINK_UNIX:
+      if (isvalid(sink->buffer))
+        _sink__stream(sink, marker, "");
+      else
+        fputs(marker, sink->file);
+      break;
+
+    case SINK_AGGREGATED:
+      // The marker closes the current aggregation window.
+      stack_table__print(sink->stacks, sink->file, 1);
+      stack_table__clear(sink->stacks);
+      fputs(marker, sink->file);
+      break;
+
+    case SINK_SQL:
+      sql__add_marker(sink->sql, label);
+      break;
+    }
+  }
+} /* sinks_marker */
+
+
+// ----------------------------------------------------------------------------
+void
+sinks_flush(void) {
+  for (register int i = 0; i < _n_sinks; i++)
+    _sink__flush(&_sinks[i]);
+} /* sinks_flush */
+
+
+// ----------------------------------------------------------------------------
+void
+sinks_close(void) {
+  for (register int i = 0; i < _n_sinks; i++)
+    _sink__close(&_sinks[i]);
+
+  _n_sinks = 0;
+} /* sinks_close */
@@ -0,0 +1,113 @@
+// This file is part of "austin" which is released under GPL.
+//
+// See file LICENCE or go to http://www.gnu.org/licenses/ for full license
+// details.
+//
+// Austin is a Python frame stack sampler for CPython.
+//
+// Copyright (c) 2018 Gabriele N. Tornetta <phoenix1987@gmail.com>.
+// All rights reserved.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef SINK_H
+#define SINK_H
+
+
+#include <sys/types.h>
+
+#include "stats.h"
+
+
+#define SINK_COLLAPSED                   0
+#define SINK_AGGREGATED                  1
+#define SINK_SQL                         2
+#define SINK_UNIX                        3
+
+// The prefix of the marker records, which are written as comments.
+#define SINK_MARKER                      "# marker: "
+
+
+/**
+ * Get the kind of sink from its specification, that is KIND:PATH.
+ *
+ * @param  char *  the sink specification.
+ *
+ * @return one of the SINK_* kinds, or -1 if the specification is not valid.
+ */
+int
+sink_kind(const char *);
+
+
+/**
+ * Open the output sinks. These are the main output file, unless only other
+ * sinks have been requested, and all the sinks given on the command line.
+ *
+ * @param  char *  the name of the profiled service, which is sent to the
+ *                 aggregators.
+ *
+ * @return either SUCCESS or FAIL.
+ */
+int
+sinks_open(const char *);
+
+
+/**
+ * Fan a sample out to all the output sinks.
+ *
+ * @param  char *   the sample stack, in the collapsed format.
+ * @param  char *   the formatted metrics, including the final new line.
+ * @param  ctime_t  the time delta.
+ * @param  ssize_t  the memory delta.
+ */
+void
+sinks_sample(const char *, const char *, ctime_t, ssize_t);
+
+
+/**
+ * Write a comment line to the sinks that stream the collapsed samples.
+ *
+ * @param  char *  the format of the comment, including the leading '#' and
+ *                 the final new line.
+ * @param  ...     the format arguments.
+ */
+void
+sinks_comment(const char *, ...);
+
+
+/**
+ * Add a marker with the given label and the current time to all the output
+ * sinks. Aggregated sinks write out their aggregate, followed by the marker,
+ * and start a new one.
+ *
+ * @param  char *  the label of the marker.
+ */
+void
+sinks_marker(const char *);
+
+
+/**
+ * Make what has been written so far available to the consumers of the sinks.
+ */
+void
+sinks_flush(void);
+
+
+/**
+ * Write out the aggregated sinks and close all the output sinks.
+ */
+void
+sinks_close(void);
+
+
+#endif // SINK_H
@@ -0,0 +1,339 @@
+// This file is part of "austin" which is released under GPL.
+//
+// See file LICENCE or go to http://www.gnu.org/licenses/ for full license
+// details.
+//
+// Austin is a Python frame stack sampler for CPython.
+//
+// Copyright (c) 2018 Gabriele N. Tornetta <phoenix1987@gmail.com>.
+// All rights reserved.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "argparse.h"
+#include "hints.h"
+#include "stack_table.h"
+
+#include "sql.h"
+
+
+#define MAXLEN                          1024
+#define MAX_STACK_SIZE                  4096
+#define SQL_ROWS_PER_INSERT              256
+#define SQL_ROWS_PER_TRANSACTION    (1 << 16)
+
+
+typedef struct {
+  char   text     [MAXLEN * 2 + 32];
+  char   scope    [MAXLEN];
+  char   filename [MAXLEN];
+  long   lineno;
+} sql_frame_t;
+
+
+// Scratch space for the frame IDs of a new stack.
+static long _sql_stack_frames[MAX_STACK_SIZE];
+
+
+static const char * _sql_schema = \
+"PRAGMA journal_mode = MEMORY;\n"
+"PRAGMA synchronous = OFF;\n"
+"BEGIN;\n"
+"CREATE TABLE strings (id INTEGER PRIMARY KEY, value TEXT NOT NULL);\n"
+"CREATE TABLE frames (id INTEGER PRIMARY KEY, scope INTEGER NOT NULL, filename INTEGER NOT NULL, line INTEGER NOT NULL);\n"
+"CREATE TABLE stacks (id INTEGER NOT NULL, depth INTEGER NOT NULL, frame INTEGER NOT NULL, PRIMARY KEY (id, depth));\n"
+"CREATE TABLE samples (timestamp INTEGER NOT NULL, pid INTEGER NOT NULL, tid INTEGER NOT NULL, stack INTEGER NOT NULL, time INTEGER NOT NULL, memory INTEGER);\n"
+"CREATE TABLE markers (timestamp INTEGER NOT NULL, label TEXT NOT NULL);\n";
+
+static const char * _sql_indexes = \
+"CREATE INDEX strings_value ON strings (value);\n"
+"CREATE INDEX frames_scope ON frames (scope);\n"
+"CREATE INDEX frames_filename ON frames (filename);\n"
+"CREATE INDEX stacks_frame ON stacks (frame);\n"
+"CREATE INDEX samples_timestamp ON samples (timestamp);\n"
+"CREATE INDEX samples_stack ON samples (stack);\n";
+
+
+// ---- PRIVATE ---------------------------------------------------------------
+
+// ----------------------------------------------------------------------------
+static void
+_sql__end_insert(sql_t * self) {
+  if (self->table == NULL)
+    return;
+
+  fputs(";\n", self->output);
+  self->table = NULL;
+  self->rows  = 0;
+
+  if (self->tx_rows >= SQL_ROWS_PER_TRANSACTION) {
+    fputs("COMMIT;\nBEGIN;\n", self->output);
+    self->tx_rows = 0;
+  }
+} /* _sql__end_insert */
+
+
+// ----------------------------------------------------------------------------
+// Start a new row of the given table. The values are then printed by the
+// caller, within parentheses.
+static void
+_sql__row(sql_t * self, const char * table) {
+  if (self->table != table || self->rows >= SQL_ROWS_PER_INSERT) {
+    _sql__end_insert(self);
+    fprintf(self->output, "INSERT INTO %s VALUES\n  ", table);
+    self->table = table;
+  }
+  else
+    fputs(",\n  ", self->output);
+
+  self->rows++;
+  self->tx_rows++;
+} /* _sql__row */
+
+
+// ----------------------------------------------------------------------------
+static void
+_sql__quote(sql_t * self, const char * value) {
+  fputc('\'', self->output);
+  for (register const char * c = value; *c; c++) {
+    if (*c == '\'')
+      fputc('\'', self->output);
+    fputc(*c, self->output);
+  }
+  fputc('\'', self->output);
+} /* _sql__quote */
+
+
+// ----------------------------------------------------------------------------
+static long
+_sql__string(sql_t * self, const char * value) {
+  stack_entry_t * entry = stack_table__get(self->strings, value);
+  if (!isvalid(entry))
+    return -1;
+
+  if (entry->values[0] == 0) {
+    entry->values[0] = self->strings->count;
+
+    _sql__row(self, "strings");
+    fprintf(self->output, "(%lu, ", entry->values[0]);
+    _sql__quote(self, value);
+    fputc(')', self->output);
+  }
+
+  return entry->values[0];
+} /* _sql__string */
+
+
+// ----------------------------------------------------------------------------
+// Split the next frame off the frames of a collapsed stack. Frames without a
+// source location, like <idle>, only have a scope. Return a pointer to what
+// follows the frame, or NULL if there are no frames left.
+static const char *
+_sql__next_frame(const char * frames, sql_frame_t * frame) {
+  const char * end   = NULL;
+  const char * paren = NULL;
+  const char * colon = NULL;
+  const char * semi  = NULL;
+
+  if (*frames == '\0')
+    return NULL;
+
+  semi  = strchr(frames, ';');
+  paren = strstr(frames, " (");
+
+  frame->filename[0] = '\0';
+  frame->lineno      = 0;
+
+  if (paren == NULL || (semi != NULL && semi < paren)) {
+    end = semi != NULL ? semi : frames + strlen(frames);
+    paren = end;
+  }
+  else if (pargs.format == SAMPLE_FORMAT_ALTERNATIVE) {
+    // <scope> (<filename>:<line>)
+    if (!isvalid(end = strstr(paren, ");")))
+      end = paren + strlen(paren) - 1;
+    for (colon = end; colon > paren + 2 && *colon != ':'; colon--);
+    if (*colon != ':')
+      colon = end;
+    if (colon - paren - 2 >= MAXLEN)
+      return NULL;
+    memcpy(frame->filename, paren + 2, colon - paren - 2);
+    frame->filename[colon - paren - 2] = '\0';
+    if (colon < end)
+      frame->lineno = strtol(colon + 1, NULL, 10);
+    end++;
+  }
+  else {
+    // <scope> (<filename>);L<line>
+    if (!isvalid(colon = strstr(paren, ");L")) || colon - paren - 2 >= MAXLEN)
+      return NULL;
+    memcpy(frame->filename, paren + 2, colon - paren - 2);
+    frame->filename[colon - paren - 2] = '\0';
+    frame->lineno = strtol(colon + 3, (char **) &end, 10);
+  }
+
+  if (paren - frames >= MAXLEN || end - frames >= (long) sizeof(frame->text))
+    return NULL;
+
+  memcpy(frame->scope, frames, paren - frames);
+  frame->scope[paren - frames] = '\0';
+
+  memcpy(frame->text, frames, end - frames);
+  frame->text[end - frames] = '\0';
+
+  return *end == ';' ? end + 1 : end;
+} /* _sql__next_frame */
+
+
+// ----------------------------------------------------------------------------
+static long
+_sql__frame(sql_t * self, sql_frame_t * frame) {
+  stack_entry_t * entry = stack_table__get(self->frames, frame->text);
+  if (!isvalid(entry))
+    return -1;
+
+  if (entry->values[0] == 0) {
+    long scope    = _sql__string(self, frame->scope);
+    long filename = _sql__string(self, frame->filename);
+    if (scope < 0 || filename < 0)
+      return -1;
+
+    entry->values[0] = self->frames->count;
+
+    _sql__row(self, "frames");
+    fprintf(self->output, "(%lu, %ld, %ld, %ld)",
+      entry->values[0], scope, filename, frame->lineno
+    );
+  }
+
+  return entry->values[0];
+} /* _sql__frame */
+
+
+// ----------------------------------------------------------------------------
+static long
+_sql__stack(sql_t * self, const char * frames) {
+  sql_frame_t     frame;
+  int             height = 0;
+  stack_entry_t * entry  = stack_table__get(self->stacks, frames);
+  if (!isvalid(entry))
+    return -1;
+
+  if (entry->values[0] != 0)
+    return entry->values[0];
+
+  // Intern all the frames first, so that the rows of the stack can be written
+  // in a single statement.
+  while (height < MAX_STACK_SIZE && isvalid(frames = _sql__next_frame(frames, &frame))) {
+    if ((_sql_stack_frames[height++] = _sql__frame(self, &frame)) < 0)
+      return -1;
+  }
+
+  entry->values[0] = self->stacks->count;
+
+  for (register int i = 0; i < height; i++) {
+    _sql__row(self, "stacks");
+    fprintf(self->output, "(%lu, %d, %ld)", entry->values[0], i, _sql_stack_frames[i]);
+  }
+
+  return entry->values[0];
+} /* _sql__stack */
+
+
+// ---- PUBLIC ----------------------------------------------------------------
+
+// ----------------------------------------------------------------------------
+sql_t *
+sql_new(FILE * output) {
+  sql_t * self = (sql_t *) calloc(1, sizeof(sql_t));
+  if (!isvalid(self))
+    return NULL;
+
+  self->strings = stack_table_new();
+  self->frames  = stack_table_new();
+  self->stacks  = stack_table_new();
+  if (!isvalid(self->strings) || !isvalid(self->frames) || !isvalid(self->stacks)) {
+    stack_table__destroy(self->strings);
+    stack_table__destroy(self->frames);
+    stack_table__destroy(self->stacks);
+    free(self);
+    return NULL;
+  }
+
+  self->output = output;
+  self->start  = gettime();
+
+  fputs(_sql_schema, self->output);
+
+  return self;
+} /* sql_new */
+
+
+// ----------------------------------------------------------------------------
+void
+sql__add_sample(sql_t * self, const char * sample, ctime_t time, ssize_t memory) {
+  char          * end = NULL;
+  long            pid = 0;
+  unsigned long   tid = 0;
+
+  // P<pid>;T<tid>[;<frames>]
+  pid = strtol(sample + 1, &end, 10);
+  if (*end != ';' || *(end + 1) != 'T')
+    return;
+  tid = strtoul(end + 2, &end, 16);
+
+  long stack = _sql__stack(self, *end == ';' ? end + 1 : "");
+  if (stack < 0)
+    return;
+
+  _sql__row(self, "samples");
+  fprintf(self->output, "(%lu, %ld, %lu, %ld, %lu, ",
+    gettime() - self->start, pid, tid, stack, time
+  );
+  if (pargs.memory)
+    fprintf(self->output, "%ld)", (long) memory);
+  else
+    fputs("NULL)", self->output);
+} /* sql__add_sample */
+
+
+// ----------------------------------------------------------------------------
+void
+sql__add_marker(sql_t * self, const char * label) {
+  _sql__row(self, "markers");
+  fprintf(self->output, "(%lu, ", gettime() - self->start);
+  _sql__quote(self, label);
+  fputc(')', self->output);
+} /* sql__add_marker */
+
+
+// ----------------------------------------------------------------------------
+void
+sql__destroy(sql_t * self) {
+  if (!isvalid(self))
+    return;
+
+  _sql__end_insert(self);
+  fputs(_sql_indexes, self->output);
+  fputs("COMMIT;\n", self->output);
+  fflush(self->output);
+
+  stack_table__destroy(self->strings);
+  stack_table__destroy(self->frames);
+  stack_table__destroy(self->stacks);
+
+  free(self);
+} /* sql__destroy */
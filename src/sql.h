@@ -0,0 +1,96 @@
+// This file is part of "austin" which is released under GPL.
+//
+// See file LICENCE or go to http://www.gnu.org/licenses/ for full license
+// details.
+//
+// Austin is a Python frame stack sampler for CPython.
+//
+// Copyright (c) 2018 Gabriele N. Tornetta <phoenix1987@gmail.com>.
+// All rights reserved.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef SQL_H
+#define SQL_H
+
+
+#include <stdio.h>
+#include <sys/types.h>
+
+#include "stats.h"
+#include "stack_table.h"
+
+
+typedef struct {
+  FILE          * output;
+  ctime_t         start;
+
+  // Interned strings, frames and stacks. The first slot holds the row ID.
+  stack_table_t * strings;
+  stack_table_t * frames;
+  stack_table_t * stacks;
+
+  // The table of the INSERT statement being written, if any. Consecutive rows
+  // of the same table are batched into a single statement.
+  const char    * table;
+  int             rows;
+  long            tx_rows;
+} sql_t;
+
+
+/**
+ * Create a new SQL writer and start the script on the given output file. The
+ * script creates a SQLite database with the normalised tables of strings,
+ * frames, stacks and samples.
+ *
+ * @param  FILE *  the output file.
+ *
+ * @return a pointer to the new SQL writer, or NULL on failure.
+ */
+sql_t *
+sql_new(FILE *);
+
+
+/**
+ * Add a sample to the SQL script. Strings, frames and stacks are written the
+ * first time they are seen only, and samples refer to them by ID.
+ *
+ * @param  sql_t    self.
+ * @param  char *   the sample stack, in the collapsed format.
+ * @param  ctime_t  the time delta.
+ * @param  ssize_t  the memory delta. This is only written in memory mode.
+ */
+void
+sql__add_sample(sql_t *, const char *, ctime_t, ssize_t);
+
+
+/**
+ * Add a marker to the SQL script, with the same time reference as the samples.
+ *
+ * @param  sql_t   self.
+ * @param  char *  the label of the marker.
+ */
+void
+sql__add_marker(sql_t *, const char *);
+
+
+/**
+ * Create the indexes, terminate the SQL script and destroy the SQL writer.
+ *
+ * @param  sql_t  self.
+ */
+void
+sql__destroy(sql_t *);
+
+
+#endif // SQL_H
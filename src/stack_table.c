@@ -0,0 +1,183 @@
+// This file is part of "austin" which is released under GPL.
+//
+// See file LICENCE or go to http://www.gnu.org/licenses/ for full license
+// details.
+//
+// Austin is a Python frame stack sampler for CPython.
+//
+// Copyright (c) 2018 Gabriele N. Tornetta <phoenix1987@gmail.com>.
+// All rights reserved.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "dict.h"
+#include "hints.h"
+
+#include "stack_table.h"
+
+
+#define STACK_TABLE_INIT_SIZE           1024
+
+
+// ---- PRIVATE ---------------------------------------------------------------
+
+// ----------------------------------------------------------------------------
+static stack_entry_t *
+_stack_table__find(stack_entry_t * entries, size_t size, const char * key, long hash) {
+  register size_t i = hash & (size - 1);
+
+  // Linear probing. The table is never full so this always terminates.
+  while (entries[i].key != NULL) {
+    if (entries[i].hash == hash && strcmp(entries[i].key, key) == 0)
+      break;
+    i = (i + 1) & (size - 1);
+  }
+
+  return &entries[i];
+} /* _stack_table__find */
+
+
+// ----------------------------------------------------------------------------
+static int
+_stack_table__grow(stack_table_t * self) {
+  size_t          size    = self->size << 1;
+  stack_entry_t * entries = (stack_entry_t *) calloc(size, sizeof(stack_entry_t));
+  if (!isvalid(entries))
+    FAIL;
+
+  for (register size_t i = 0; i < self->size; i++) {
+    stack_entry_t * entry = &(self->entries[i]);
+    if (entry->key != NULL)
+      *_stack_table__find(entries, size, entry->key, entry->hash) = *entry;
+  }
+
+  free(self->entries);
+  self->entries = entries;
+  self->size    = size;
+
+  SUCCESS;
+} /* _stack_table__grow */
+
+
+// ---- PUBLIC ----------------------------------------------------------------
+
+// ----------------------------------------------------------------------------
+stack_table_t *
+stack_table_new(void) {
+  stack_table_t * table = (stack_table_t *) calloc(1, sizeof(stack_table_t));
+  if (!isvalid(table))
+    return NULL;
+
+  table->entries = (stack_entry_t *) calloc(STACK_TABLE_INIT_SIZE, sizeof(stack_entry_t));
+  if (!isvalid(table->entries)) {
+    free(table);
+    return NULL;
+  }
+  table->size = STACK_TABLE_INIT_SIZE;
+
+  return table;
+} /* stack_table_new */
+
+
+// ----------------------------------------------------------------------------
+stack_entry_t *
+stack_table__get(stack_table_t * self, const char * key) {
+  long            hash  = string_hash((char *) key);
+  stack_entry_t * entry = _stack_table__find(self->entries, self->size, key, hash);
+
+  if (entry->key == NULL) {
+    // Keep the load factor below 3/4.
+    if ((self->count + 1) << 2 > self->size * 3) {
+      if (fail(_stack_table__grow(self)))
+        return NULL;
+      entry = _stack_table__find(self->entries, self->size, key, hash);
+    }
+
+    if (!isvalid(entry->key = strdup(key)))
+      return NULL;
+    entry->hash = hash;
+    self->count++;
+  }
+
+  return entry;
+} /* stack_table__get */
+
+
+// ----------------------------------------------------------------------------
+int
+stack_table__add(stack_table_t * self, const char * key, int slot, ctime_t value) {
+  stack_entry_t * entry = stack_table__get(self, key);
+  if (!isvalid(entry))
+    FAIL;
+
+  entry->values[slot] += value;
+
+  SUCCESS;
+} /* stack_table__add */
+
+
+// ----------------------------------------------------------------------------
+void
+stack_table__print(stack_table_t * self, FILE * output, int slots) {
+  for (register size_t i = 0; i < self->size; i++) {
+    stack_entry_t * entry = &(self->entries[i]);
+    if (entry->key == NULL)
+      continue;
+
+    fputs(entry->key, output);
+    for (register int slot = 0; slot < slots; slot++)
+      fprintf(output, " %ld", (long) entry->values[slot]);
+    fputc('\n', output);
+  }
+} /* stack_table__print */
+
+
+// ----------------------------------------------------------------------------
+void
+stack_table__print_diff(stack_table_t * self, FILE * output, double scale) {
+  for (register size_t i = 0; i < self->size; i++) {
+    stack_entry_t * entry = &(self->entries[i]);
+    if (entry->key != NULL)
+      fprintf(output, "%s %lu %lu\n",
+        entry->key, entry->values[0], (ctime_t) (entry->values[1] * scale + .5)
+      );
+  }
+} /* stack_table__print_diff */
+
+
+// ----------------------------------------------------------------------------
+void
+stack_table__clear(stack_table_t * self) {
+  for (register size_t i = 0; i < self->size; i++)
+    sfree(self->entries[i].key);
+
+  memset(self->entries, 0, self->size * sizeof(stack_entry_t));
+  self->count = 0;
+} /* stack_table__clear */
+
+
+// ----------------------------------------------------------------------------
+void
+stack_table__destroy(stack_table_t * self) {
+  if (!isvalid(self))
+    return;
+
+  for (register size_t i = 0; i < self->size; i++)
+    sfree(self->entries[i].key);
+
+  free(self->entries);
+  free(self);
+} /* stack_table__destroy */
@@ -0,0 +1,132 @@
+// This file is part of "austin" which is released under GPL.
+//
+// See file LICENCE or go to http://www.gnu.org/licenses/ for full license
+// details.
+//
+// Austin is a Python frame stack sampler for CPython.
+//
+// Copyright (c) 2018 Gabriele N. Tornetta <phoenix1987@gmail.com>.
+// All rights reserved.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef STACK_TABLE_H
+#define STACK_TABLE_H
+
+
+#include <stdio.h>
+
+#include "stats.h"
+
+
+// Number of independent values that are kept for each stack.
+#define STACK_TABLE_SLOTS                2
+
+
+typedef struct {
+  char    * key;
+  long      hash;
+  ctime_t   values[STACK_TABLE_SLOTS];
+} stack_entry_t;
+
+
+typedef struct {
+  stack_entry_t * entries;
+  size_t          size;   // Always a power of 2.
+  size_t          count;
+} stack_table_t;
+
+
+/**
+ * Create a new, empty, stack table.
+ *
+ * @return a pointer to the new stack table, or NULL on failure.
+ */
+stack_table_t *
+stack_table_new(void);
+
+
+/**
+ * Get the entry of a stack. The stack is added to the table, with all its
+ * values set to 0, if it is not there already.
+ *
+ * @param  stack_table_t  self.
+ * @param  char *         the collapsed stack, used as the key.
+ *
+ * @return a pointer to the entry, or NULL on failure. The pointer is valid
+ *         until the next stack is added to the table.
+ */
+stack_entry_t *
+stack_table__get(stack_table_t *, const char *);
+
+
+/**
+ * Add a value to a slot of a stack. The stack is added to the table if it is
+ * not there already.
+ *
+ * @param  stack_table_t  self.
+ * @param  char *         the collapsed stack, used as the key.
+ * @param  int            the slot, in [0, STACK_TABLE_SLOTS).
+ * @param  ctime_t        the value to add.
+ *
+ * @return either SUCCESS or FAIL.
+ */
+int
+stack_table__add(stack_table_t *, const char *, int, ctime_t);
+
+
+/**
+ * Print the stacks in the collapsed format, that is, the stack followed by
+ * the values of the first slots. The values are printed as signed, so that the
+ * slots can also sum negative values, like memory deltas.
+ *
+ * @param  stack_table_t  self.
+ * @param  FILE *         the output file.
+ * @param  int            the number of slots to print, in [1, STACK_TABLE_SLOTS].
+ */
+void
+stack_table__print(stack_table_t *, FILE *, int);
+
+
+/**
+ * Print the stacks in the differential collapsed format, that is, the stack
+ * followed by the values of the first and the second slot. The values in the
+ * second slot are rescaled by the given factor.
+ *
+ * @param  stack_table_t  self.
+ * @param  FILE *         the output file.
+ * @param  double         the scaling factor for the second slot.
+ */
+void
+stack_table__print_diff(stack_table_t *, FILE *, double);
+
+
+/**
+ * Remove all the stacks from the table. The table keeps its size.
+ *
+ * @param  stack_table_t  self.
+ */
+void
+stack_table__clear(stack_table_t *);
+
+
+/**
+ * Destroy the stack table.
+ *
+ * @param  stack_table_t  self.
+ */
+void
+stack_table__destroy(stack_table_t *);
+
+
+#endif // STACK_TABLE_H
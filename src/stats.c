@@ -25,6 +25,7 @@
 #include "platform.h"
 
 #include <limits.h>
+#include <string.h>
 #include <time.h>
 
 #if defined PL_MACOS
@@ -34,6 +35,7 @@
 #include <profileapi.h>
 #endif
 
+#include "argparse.h"
 #include "error.h"
 #include "logging.h"
 #include "stats.h"
@@ -58,6 +60,9 @@ ctime_t _avg_sampling_time;
 ustat_t _error_cnt;
 ustat_t _long_cnt;
 
+ustat_t _frame_window_hits;
+ustat_t _frame_window_misses;
+
 #if defined PL_WIN
 // On Windows we have to use the QueryPerformance APIs in order to get the
 // right time resolution. We use this variable to cache the inverse frequency
@@ -104,6 +109,9 @@ stats_reset(void) {
   _sample_cnt = 0;
   _error_cnt  = 0;
 
+  _frame_window_hits   = 0;
+  _frame_window_misses = 0;
+
   _min_sampling_time = ULONG_MAX;
   _max_sampling_time = 0;
   _avg_sampling_time = 0;
@@ -158,4 +166,84 @@ stats_log_metrics(void) {
     _sample_cnt,                                         \
     (float) _error_cnt / _sample_cnt * 100               \
   );
+
+  if (pargs.frame_window && _frame_window_hits + _frame_window_misses) {
+    log_m("🔭 Frame window hit rate : %lu/%lu (%.2f %%) frames read from the window",
+      _frame_window_hits,
+      _frame_window_hits + _frame_window_misses,
+      (float) _frame_window_hits / (_frame_window_hits + _frame_window_misses) * 100
+    );
+  }
+}
+
+
+void
+proc_stats_reset(proc_stats_t * self) {
+  memset(self, 0, sizeof(proc_stats_t));
+
+  self->min_sampling_time = ULONG_MAX;
+}
+
+
+void
+proc_stats_record(proc_stats_t * self, ctime_t delta, int is_error) {
+  ctime_t now = gettime();
+  int     bucket = 0;
+
+  if (self->sample_cnt++ == 0)
+    self->first_sample_time = now;
+  self->last_sample_time = now;
+
+  if (is_error)
+    self->error_cnt++;
+
+  if (delta > pargs.t_sampling_interval)
+    self->long_cnt++;
+  if (self->min_sampling_time > delta)
+    self->min_sampling_time = delta;
+  if (self->max_sampling_time < delta)
+    self->max_sampling_time = delta;
+  self->tot_sampling_time += delta;
+
+  while (delta && bucket < STATS_BUCKETS - 1) {
+    delta >>= 1;
+    bucket++;
+  }
+  self->buckets[bucket]++;
+}
+
+
+ctime_t
+proc_stats_get_percentile(proc_stats_t * self, float p) {
+  ustat_t target = p * self->sample_cnt;
+  ustat_t count  = 0;
+
+  for (register int i = 0; i < STATS_BUCKETS; i++) {
+    count += self->buckets[i];
+    if (count >= target && count)
+      return (ctime_t) 1 << i;
+  }
+
+  return self->max_sampling_time;
+}
+
+
+void
+proc_stats_log_metrics(proc_stats_t * self, int pid) {
+  if (!self->sample_cnt)
+    return;
+
+  ctime_t span = self->last_sample_time - self->first_sample_time;
+
+  log_m("📊 Process %d : %lu samples @ %.1f Hz, sampling time (min/avg/p99/max) %lu/%lu/%lu/%lu μs, %.2f %% long, %.2f %% invalid",
+    pid,
+    self->sample_cnt,
+    span ? (self->sample_cnt - 1) * 1e6 / span : 0.0,
+    self->min_sampling_time,
+    self->tot_sampling_time / self->sample_cnt,
+    proc_stats_get_percentile(self, .99),
+    self->max_sampling_time,
+    (float) self->long_cnt / self->sample_cnt * 100,
+    (float) self->error_cnt / self->sample_cnt * 100
+  );
 }
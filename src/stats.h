@@ -28,6 +28,30 @@ typedef unsigned long ctime_t;  /* Forward */
 typedef unsigned long ustat_t;  /* non-negative statistics metric */
 
 
+// Number of buckets in the sampling time histograms. Bucket i counts the
+// sampling times with a bit length of i, that is, in the range [2^(i-1), 2^i).
+#define STATS_BUCKETS                   32
+
+
+/**
+ * Sampling statistics of a single process.
+ */
+typedef struct {
+  ustat_t sample_cnt;
+  ustat_t error_cnt;
+  ustat_t long_cnt;
+
+  ctime_t min_sampling_time;
+  ctime_t max_sampling_time;
+  ctime_t tot_sampling_time;
+
+  ctime_t first_sample_time;
+  ctime_t last_sample_time;
+
+  ustat_t buckets[STATS_BUCKETS];
+} proc_stats_t;
+
+
 #ifndef STATS_C
 extern unsigned long _sample_cnt;
 
@@ -37,6 +61,9 @@ extern ctime_t _avg_sampling_time;
 
 extern ustat_t _error_cnt;
 extern ustat_t _long_cnt;
+
+extern ustat_t _frame_window_hits;
+extern ustat_t _frame_window_misses;
 #endif
 
 
@@ -89,6 +116,18 @@ stats_get_avg_sampling_time(void);
 #define stats_count_error()             { _error_cnt++; }
 
 
+/**
+ * Increase the counter of frames that were read from the frame window.
+ */
+#define stats_count_frame_window_hit()  { _frame_window_hits++; }
+
+
+/**
+ * Increase the counter of frames that required a new frame window.
+ */
+#define stats_count_frame_window_miss() { _frame_window_misses++; }
+
+
 /**
  * Check the duration of the last sampling and update the statistics.
  *
@@ -112,4 +151,45 @@ stats_get_avg_sampling_time(void);
 void
 stats_log_metrics(void);
 
+
+/**
+ * Reset the sampling statistics of a process.
+ *
+ * @param proc_stats_t the statistics to reset.
+ */
+void
+proc_stats_reset(proc_stats_t *);
+
+
+/**
+ * Record a sample in the sampling statistics of a process.
+ *
+ * @param proc_stats_t the statistics to update.
+ * @param ctime_t      the time it took to obtain the sample.
+ * @param int          whether the sample was invalid.
+ */
+void
+proc_stats_record(proc_stats_t *, ctime_t, int);
+
+
+/**
+ * Get an estimate of a percentile of the sampling time, rounded up to the
+ * next power of two.
+ *
+ * @param proc_stats_t the statistics to query.
+ * @param float        the percentile, as a fraction in [0, 1].
+ */
+ctime_t
+proc_stats_get_percentile(proc_stats_t *, float);
+
+
+/**
+ * Log the sampling statistics of a process.
+ *
+ * @param proc_stats_t the statistics to log.
+ * @param int          the PID of the process the statistics refer to.
+ */
+void
+proc_stats_log_metrics(proc_stats_t *, int);
+
 #endif
@@ -40,6 +40,16 @@ function attach_austin {
     assert_success
     assert_output ";<module> (.*test/sleepy.py);L[[:digit:]]* "
 
+  # -------------------------------------------------------------------------
+  step "Dump"
+  # -------------------------------------------------------------------------
+    $python_bin test/sleepy.py &
+    sleep 1
+    run sudo $AUSTIN -D -p $!
+
+    assert_success
+    assert_output "^    <module> (.*test/sleepy.py:[[:digit:]]*)$"
+
 }
 
 
@@ -47,6 +47,14 @@ function invoke_austin {
     assert_success
     assert_output "keep_cpu_busy (.*test/target34.py);L"
 
+  # -------------------------------------------------------------------------
+  step "Memory profiling with memory interval"
+  # -------------------------------------------------------------------------
+    run sudo $AUSTIN -i 100 -t 10000 -M 10ms -f $python_bin test/target34.py
+
+    assert_success
+    assert_output "keep_cpu_busy (.*test/target34.py);L[0-9]* [0-9]* [0-9]* -\?[0-9]*$"
+
   # -------------------------------------------------------------------------
   step "Output file"
   # -------------------------------------------------------------------------
@@ -57,12 +65,90 @@ function invoke_austin {
     assert_not_output "keep_cpu_busy (.*test/target34.py);L"
     assert_file "/tmp/austin_out.txt" "keep_cpu_busy (.*test/target34.py);L"
 
+  # -------------------------------------------------------------------------
+  step "Burst sampling"
+  # -------------------------------------------------------------------------
+    run sudo $AUSTIN -i 1000 -t 10000 -b 10ms,50ms $python_bin test/target34.py
+
+    assert_success
+    assert_output "# burst: 2 @ [0-9]*us"
+    assert_output "keep_cpu_busy (.*test/target34.py);L"
+
+  # -------------------------------------------------------------------------
+  step "Instruction heat"
+  # -------------------------------------------------------------------------
+    run sudo $AUSTIN -i 1000 -t 10000 -H $python_bin test/target34.py
+
+    assert_success
+    assert_output "keep_cpu_busy (.*test/target34.py);L[0-9]*;F28;I[0-9]* [0-9]* [0-9]*$"
+    assert_not_output "P[0-9]*;T[0-9a-f]*;"
+
+  # -------------------------------------------------------------------------
+  step "SQL output"
+  # -------------------------------------------------------------------------
+    run sudo $AUSTIN -i 1000 -t 10000 -Q $python_bin test/target34.py
+
+    assert_success
+    assert_output "^CREATE TABLE samples"
+    assert_output "^  ([0-9]*, '.*test/target34.py')"
+    assert_output "^CREATE INDEX samples_stack ON samples (stack);$"
+    assert_not_output "keep_cpu_busy (.*test/target34.py);L"
+
+  # -------------------------------------------------------------------------
+  step "Multiple sinks"
+  # -------------------------------------------------------------------------
+    run sudo $AUSTIN -i 1000 -t 10000 -o /tmp/austin_out.txt -O aggregated:/tmp/austin_agg.txt -O sql:/tmp/austin_out.sql $python_bin test/target34.py
+
+    assert_success
+    assert_file "/tmp/austin_out.txt" "keep_cpu_busy (.*test/target34.py);L[0-9]* [0-9]*$"
+    assert_file "/tmp/austin_agg.txt" "keep_cpu_busy (.*test/target34.py);L[0-9]* [0-9]*$"
+    assert_file "/tmp/austin_out.sql" "^CREATE INDEX samples_stack ON samples (stack);$"
+
+  # -------------------------------------------------------------------------
+  step "Frame window"
+  # -------------------------------------------------------------------------
+    run sudo $AUSTIN -i 1000 -t 10000 -w 4096 $python_bin test/target34.py
+
+    assert_success
+    assert_output "keep_cpu_busy (.*test/target34.py);L[0-9]* [0-9]*$"
+
+  # -------------------------------------------------------------------------
+  step "Aggregator"
+  # -------------------------------------------------------------------------
+    local agg_dir=$(mktemp -d)
+    sudo $AUSTIN -A $agg_dir &
+    local agg_pid=$!
+    sleep 1
+    run sudo $AUSTIN -i 1000 -t 10000 -O unix:$agg_dir/austin.sock $python_bin test/target34.py
+    sudo kill -INT $agg_pid
+    wait $agg_pid || true
+
+    assert_success
+    assert_file "$(ls $agg_dir/target34.py.*.austin | head -n 1)" "^[^P].*keep_cpu_busy (.*test/target34.py);L[0-9]* [0-9]*$"
+    sudo rm -rf $agg_dir
+
+  # -------------------------------------------------------------------------
+  step "Markers"
+  # -------------------------------------------------------------------------
+    local markers=$(mktemp -u)
+    mkfifo $markers
+    ( sleep 0.5; echo "phase 2" > $markers ) &
+    run sudo $AUSTIN -i 1000 -t 10000 -L $markers $python_bin test/sleepy.py
+    wait
+
+    assert_success
+    assert_output "^# marker: phase 2 @ [0-9]*us$"
+    assert_output "cpu_bound (.*test/sleepy.py);L[0-9]* [0-9]*$"
+    rm -f $markers
+
 }
 
 # -----------------------------------------------------------------------------
 
 teardown() {
   if [ -f /tmp/austin_out.txt ]; then rm /tmp/austin_out.txt; fi
+  if [ -f /tmp/austin_agg.txt ]; then rm /tmp/austin_agg.txt; fi
+  if [ -f /tmp/austin_out.sql ]; then rm /tmp/austin_out.sql; fi
 }
 
 
@@ -0,0 +1,67 @@
+#!/usr/bin/env python3
+
+# This file is part of "austin" which is released under GPL.
+#
+# See file LICENCE or go to http://www.gnu.org/licenses/ for full license
+# details.
+#
+# Austin is a Python frame stack sampler for CPython.
+#
+# Copyright (c) 2019 Gabriele N. Tornetta <phoenix1987@gmail.com>.
+# All rights reserved.
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+import mmap
+import threading
+import time
+
+# Each thread does a different kind of work, so that the task metrics of each
+# thread can be told apart by its stack.
+
+DURATION = 1.5
+PAGE = mmap.PAGESIZE
+CHUNK = 1 << 20
+
+
+def toucher():
+    end = time.time() + DURATION
+    while time.time() < end:
+        m = mmap.mmap(-1, 256 * PAGE)
+        for i in range(0, len(m), PAGE):
+            m[i:i + 1] = b"x"
+        m.close()
+
+
+def writer():
+    data = b"x" * CHUNK
+    end = time.time() + DURATION
+    with open("/dev/null", "wb") as f:
+        while time.time() < end:
+            f.write(data)
+            f.flush()
+            time.sleep(0.01)
+
+
+def sleeper():
+    end = time.time() + DURATION
+    while time.time() < end:
+        time.sleep(0.005)
+
+
+if __name__ == "__main__":
+    threads = [threading.Thread(target=t) for t in (toucher, writer, sleeper)]
+    for t in threads:
+        t.start()
+    for t in threads:
+        t.join()
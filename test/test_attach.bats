@@ -25,6 +25,7 @@ load "common"
 
 function attach_austin {
   local version="${1}"
+  local skipped=""
 
   check_python $version
 
@@ -40,6 +41,99 @@ function attach_austin {
     assert_success
     assert_output "(.*test/sleepy.py);L[[:digit:]]* "
 
+  # -------------------------------------------------------------------------
+  step "Differential profiling"
+  # -------------------------------------------------------------------------
+    $PYTHON test/sleepy.py &
+    local pid_a=$!
+    $PYTHON test/sleepy.py &
+    local pid_b=$!
+    sleep 1
+    run $AUSTIN -i 10ms -t 100 -p $pid_a -d $pid_b
+
+    assert_success
+    assert_output "^[^P].*(.*test/sleepy.py);L[[:digit:]]* [[:digit:]]* [[:digit:]]*$"
+    assert_not_output "^P[[:digit:]]*;T"
+
+  # -------------------------------------------------------------------------
+  step "Dump"
+  # -------------------------------------------------------------------------
+    $PYTHON test/sleepy.py &
+    sleep 1
+    run $AUSTIN -D -p $!
+
+    assert_success
+    assert_output "^Process [[:digit:]]* (Python [23]\.[[:digit:]]*)$"
+    assert_output "^    <module> (.*test/sleepy.py:[[:digit:]]*)$"
+
+  # -------------------------------------------------------------------------
+  step "Dump process tree"
+  # -------------------------------------------------------------------------
+    $PYTHON test/target_mp.py &
+    sleep 1
+    run $AUSTIN -D -C -p $!
+
+    assert_success
+    assert_output "^    fact (.*test/target_mp.py:[[:digit:]]*)$"
+    assert_output "^    join (.*multiprocessing/process.py:[[:digit:]]*)$"
+
+  # -------------------------------------------------------------------------
+  step "Cgroup"
+  # -------------------------------------------------------------------------
+    # This requires a cgroup v2 hierarchy, which hosts with cgroup v1
+    # controllers might mount on its own, e.g. on /sys/fs/cgroup/unified.
+    local cgroup_root=$(awk '$3 == "cgroup2" { print $2; exit }' /proc/mounts)
+    if [ -z "$cgroup_root" ]; then
+      skipped="$skipped No cgroup v2 hierarchy."
+    else
+      local cgroup=$cgroup_root/austin-$$
+      $PYTHON test/sleepy.py &
+      local pid=$!
+      mkdir $cgroup && echo $pid > $cgroup/cgroup.procs
+      assert "Process $pid moved to $cgroup" "-n \"$(grep -x $pid $cgroup/cgroup.procs 2>/dev/null)\""
+
+      sleep 1
+      run $AUSTIN -i 10ms -x 1 -G $cgroup
+      kill $pid
+      wait $pid || true
+
+      assert_success
+      assert_output "P$pid;T[0-9a-f]*;.*(.*test/sleepy.py);L[[:digit:]]* [[:digit:]]*$"
+      rmdir $cgroup 2>/dev/null || true
+    fi
+
+  # -------------------------------------------------------------------------
+  step "Core file"
+  # -------------------------------------------------------------------------
+    local core_pattern=$(cat /proc/sys/kernel/core_pattern)
+    if [[ "$core_pattern" == \|* || "$core_pattern" == */* ]]; then
+      skipped="$skipped Core files are not dumped in the working directory (core_pattern: $core_pattern)."
+    else
+      local core_dir=$(mktemp -d)
+      ( ulimit -c unlimited; cd $core_dir && exec $PYTHON $OLDPWD/test/sleepy.py ) &
+      local pid=$!
+      sleep 1
+      kill -ABRT $pid
+      wait $pid || true
+
+      local core_file=$(ls $core_dir/core* 2>/dev/null | head -n 1)
+      assert "Core file dumped in $core_dir" "-n \"$core_file\""
+
+      if [ -n "$core_file" ]; then
+        run $AUSTIN -k $core_file
+
+        assert_success
+        assert_output "P$pid;T[0-9a-f]*;.*(.*test/sleepy.py);L[[:digit:]]* [[:digit:]]*$"
+      fi
+      rm -rf $core_dir
+    fi
+
+  # Skipping ends the test case, so the steps that cannot run here are only
+  # reported once all the others have passed.
+  if [ -n "$skipped" ] && [ $FAIL == 0 ]; then
+    skip "$skipped"
+  fi
+
 }
 
 
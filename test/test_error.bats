@@ -68,6 +68,34 @@ load "common"
   assert_output "Cannot launch"
 }
 
+@test "Test invalid memory interval" {
+  log "Test Austin with an invalid memory interval"
+
+  run src/austin -M 10ms python3 -c pass
+
+  assert_status 64 || assert_status 252
+  assert_output "the -M option requires one of the -m, -f and -S options"
+
+  run src/austin -m -M 0 python3 -c pass
+
+  assert_status 64 || assert_status 252
+  assert_output "the memory interval must be a positive integer"
+}
+
+@test "Test incompatible options" {
+  log "Test Austin with incompatible options"
+
+  run src/austin -C -d 1 -p 1
+
+  assert_status 64 || assert_status 252
+  assert_output "the -d option is incompatible with the -m, -f and -C options"
+
+  run src/austin -H -m python3 -c pass
+
+  assert_status 64 || assert_status 252
+  assert_output "the -H option only supports time sampling"
+}
+
 @test "Test invalid PID" {
   log "Test Austin with an invalid PID"
 
@@ -47,6 +47,22 @@ function invoke_austin {
     assert_success
     assert_output "keep_cpu_busy (.*test/target34.py);L"
 
+  # -------------------------------------------------------------------------
+  step "Memory profiling with memory interval"
+  # -------------------------------------------------------------------------
+    run $AUSTIN -i 100 -t 1000 -M 10ms -f $PYTHON test/target34.py
+
+    assert_success
+    assert_output "keep_cpu_busy (.*test/target34.py);L[0-9]* [0-9]* [0-9]* -\?[0-9]*$"
+
+  # -------------------------------------------------------------------------
+  step "Memory profiling with smaps"
+  # -------------------------------------------------------------------------
+    run $AUSTIN -i 100 -t 1000 -M 10ms -S $PYTHON test/target34.py
+
+    assert_success
+    assert_output "keep_cpu_busy (.*test/target34.py);L[0-9]* -\?[0-9]* -\?[0-9]* -\?[0-9]* -\?[0-9]*$"
+
   # -------------------------------------------------------------------------
   step "Output file"
   # -------------------------------------------------------------------------
@@ -57,12 +73,169 @@ function invoke_austin {
     assert_not_output "keep_cpu_busy (.*test/target34.py);L"
     assert_file "/tmp/austin_out.txt" "keep_cpu_busy (.*test/target34.py);L"
 
+  # -------------------------------------------------------------------------
+  step "Page faults"
+  # -------------------------------------------------------------------------
+    run $AUSTIN -i 1ms -t 1s -F $PYTHON test/target_tasks.py
+
+    assert_success
+    assert_output "toucher (.*test/target_tasks.py);L[0-9]* [0-9]* [0-9]* [0-9]*$"
+
+    # The toucher maps 256 fresh pages at a time and touches each of them.
+    local minflt=$( echo "$output" | grep "toucher (" | awk '{ s += $(NF-1) } END { print s + 0 }' )
+    local others=$( echo "$output" | grep "writer (\|sleeper (" | awk '{ s += $(NF-1) } END { print s + 0 }' )
+    assert "Minor faults on the toucher ($minflt >= 256)" "$minflt -ge 256"
+    assert "Most minor faults on the toucher ($minflt > $others)" "$minflt -gt $others"
+
+  # -------------------------------------------------------------------------
+  step "Context switches"
+  # -------------------------------------------------------------------------
+    run $AUSTIN -i 1ms -t 1s -c $PYTHON test/target_tasks.py
+
+    assert_success
+    assert_output "sleeper (.*test/target_tasks.py);L[0-9]* [0-9]* [0-9]* [0-9]*$"
+
+    # The sleeper blocks in time.sleep every 5 ms, the toucher never blocks.
+    local vcsw=$( echo "$output" | grep "sleeper (" | awk '{ s += $(NF-1) } END { print s + 0 }' )
+    local others=$( echo "$output" | grep "toucher (" | awk '{ s += $(NF-1) } END { print s + 0 }' )
+    assert "Voluntary switches on the sleeper ($vcsw >= 50)" "$vcsw -ge 50"
+    assert "More voluntary switches on the sleeper ($vcsw > $others)" "$vcsw -gt $others"
+
+  # -------------------------------------------------------------------------
+  step "I/O"
+  # -------------------------------------------------------------------------
+    run $AUSTIN -i 1ms -t 1s -I $PYTHON test/target_tasks.py
+
+    assert_success
+    assert_output "writer (.*test/target_tasks.py);L[0-9]* [0-9]* [0-9]* [0-9]*$"
+
+    # The writer writes 1 MB at a time, the other threads write nothing.
+    local wchar=$( echo "$output" | grep "writer (" | awk '{ s += $NF } END { print s + 0 }' )
+    local others=$( echo "$output" | grep "toucher (\|sleeper (" | awk '{ s += $NF } END { print s + 0 }' )
+    assert "Bytes written by the writer ($wchar >= 1048576)" "$wchar -ge 1048576"
+    assert "No bytes written by the other threads ($others == 0)" "$others -eq 0"
+
+  # -------------------------------------------------------------------------
+  step "NUMA"
+  # -------------------------------------------------------------------------
+    run $AUSTIN -i 1ms -t 1s -N $PYTHON test/target34.py
+
+    assert_success
+    assert_output "P[0-9]*;T[0-9a-f]*;N[0-9]*;C[0-9]*;.*keep_cpu_busy (.*test/target34.py);L[0-9]* [0-9]*$"
+
+  # -------------------------------------------------------------------------
+  step "Memory from /proc/pid/mem"
+  # -------------------------------------------------------------------------
+    run $AUSTIN -i 1ms -t 1s -P $PYTHON test/target34.py
+
+    assert_success
+    assert_output "keep_cpu_busy (.*test/target34.py);L"
+
+  # -------------------------------------------------------------------------
+  step "Burst sampling"
+  # -------------------------------------------------------------------------
+    run $AUSTIN -i 1ms -t 1s -b 10ms,50ms $PYTHON test/target34.py
+
+    assert_success
+    assert_output "# burst: 2 @ [0-9]*us"
+    assert_output "keep_cpu_busy (.*test/target34.py);L"
+
+  # -------------------------------------------------------------------------
+  step "Overhead"
+  # -------------------------------------------------------------------------
+    run $AUSTIN -i 1ms -t 1s --overhead=true -b 100ms,100ms $PYTHON test/sleepy.py
+
+    assert_success
+    assert_output "Overhead on the sampled process"
+    assert_output "Probe throughput"
+
+  # -------------------------------------------------------------------------
+  step "Instruction heat"
+  # -------------------------------------------------------------------------
+    run $AUSTIN -i 1ms -t 1s -H $PYTHON test/target34.py
+
+    assert_success
+    assert_output "keep_cpu_busy (.*test/target34.py);L[0-9]*;F28;I[0-9]* [0-9]* [0-9]*$"
+    assert_not_output "P[0-9]*;T[0-9a-f]*;"
+
+  # -------------------------------------------------------------------------
+  step "Instruction heat (recursion)"
+  # -------------------------------------------------------------------------
+    local start=$(date +%s%N)
+    run $AUSTIN -i 1ms -x 2 -H $PYTHON test/target_deep.py
+    local wall=$(( ($(date +%s%N) - start) / 1000 ))
+
+    assert_success
+    assert_output "recurse (.*test/target_deep.py);L[0-9]*;F28;I[0-9]* [0-9]* [0-9]*$"
+
+    local max_total=$( echo "$output" | grep ";I[0-9]* [0-9]* [0-9]*$" | awk '{ if ($NF > m) m = $NF } END { print m + 0 }' )
+    assert "Total time within the wall time ($max_total <= $wall)" "$max_total -le $wall"
+
+  # -------------------------------------------------------------------------
+  step "SQL output"
+  # -------------------------------------------------------------------------
+    run $AUSTIN -i 1ms -t 1s -Q $PYTHON test/target34.py
+
+    assert_success
+    assert_output "^CREATE TABLE samples"
+    assert_output "^  ([0-9]*, '.*test/target34.py')"
+    assert_output "^CREATE INDEX samples_stack ON samples (stack);$"
+    assert_not_output "keep_cpu_busy (.*test/target34.py);L"
+
+  # -------------------------------------------------------------------------
+  step "Multiple sinks"
+  # -------------------------------------------------------------------------
+    run $AUSTIN -i 1ms -t 1s -o /tmp/austin_out.txt -O aggregated:/tmp/austin_agg.txt -O sql:/tmp/austin_out.sql $PYTHON test/target34.py
+
+    assert_success
+    assert_file "/tmp/austin_out.txt" "keep_cpu_busy (.*test/target34.py);L[0-9]* [0-9]*$"
+    assert_file "/tmp/austin_agg.txt" "keep_cpu_busy (.*test/target34.py);L[0-9]* [0-9]*$"
+    assert_file "/tmp/austin_out.sql" "^CREATE INDEX samples_stack ON samples (stack);$"
+
+  # -------------------------------------------------------------------------
+  step "Frame window"
+  # -------------------------------------------------------------------------
+    run $AUSTIN -i 1ms -t 1s -w 4096 $PYTHON test/target34.py
+
+    assert_success
+    assert_output "keep_cpu_busy (.*test/target34.py);L[0-9]* [0-9]*$"
+
+  # -------------------------------------------------------------------------
+  step "Aggregator"
+  # -------------------------------------------------------------------------
+    local agg_dir=$(mktemp -d)
+    $AUSTIN -A $agg_dir &
+    local agg_pid=$!
+    sleep 1
+    run $AUSTIN -i 1ms -t 1s -O unix:$agg_dir/austin.sock $PYTHON test/target34.py
+    kill -INT $agg_pid
+    wait $agg_pid || true
+
+    assert_success
+    assert_file "$(ls $agg_dir/target34.py.*.austin | head -n 1)" "^[^P].*keep_cpu_busy (.*test/target34.py);L[0-9]* [0-9]*$"
+    rm -rf $agg_dir
+
+  # -------------------------------------------------------------------------
+  step "Markers"
+  # -------------------------------------------------------------------------
+    local markers=$(mktemp -u)
+    ( sleep 0.5; echo "phase 2" > $markers ) &
+    run $AUSTIN -i 1ms -t 1s -L $markers $PYTHON test/sleepy.py
+    wait
+
+    assert_success
+    assert_output "^# marker: phase 2 @ [0-9]*us$"
+    assert_output "cpu_bound (.*test/sleepy.py);L[0-9]* [0-9]*$"
+    rm -f $markers
+
 }
 
 # -----------------------------------------------------------------------------
 
 function teardown {
   if [ -f /tmp/austin_out.txt ]; then rm /tmp/austin_out.txt; fi
+  if [ -f /tmp/austin_agg.txt ]; then rm /tmp/austin_agg.txt; fi
+  if [ -f /tmp/austin_out.sql ]; then rm /tmp/austin_out.sql; fi
 }
 
 
@@ -43,6 +43,14 @@ function invoke_austin {
 
     assert_output "do (.*test/target_mp.py);L[[:digit:]]*;fact (.*test/target_mp.py);L"
 
+  # -------------------------------------------------------------------------
+  step "Per-process sampling statistics"
+  # -------------------------------------------------------------------------
+    run $AUSTIN -i 10ms -C $PYTHON test/target_mp.py
+
+    assert_success
+    assert_output "Process [0-9]* : [0-9]* samples @ [0-9.]* Hz"
+
 }
 
 